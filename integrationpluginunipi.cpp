@@ -31,21 +31,51 @@
 #include "integrationpluginunipi.h"
 #include "plugininfo.h"
 #include "hardware/i2c/i2cmanager.h"
+#include "nymeasettings.h"
 
+#include <QDateTime>
+#include <QDir>
 #include <QJsonDocument>
 #include <QTimer>
 #include <QSerialPort>
 
+static ModbusValueCodec::WordOrder analogWordOrder(const QVariant &value)
+{
+    if (value.toString() == "Low word first")
+        return ModbusValueCodec::LowWordFirst;
+
+    return ModbusValueCodec::HighWordFirst;
+}
+
 IntegrationPluginUniPi::IntegrationPluginUniPi()
 {
 }
 
+IntegrationPluginUniPi::~IntegrationPluginUniPi()
+{
+    if (m_ioSnapshot.isDirty())
+        m_ioSnapshot.save(m_ioSnapshotFileName);
+}
+
 
 void IntegrationPluginUniPi::init()
 {
     connect(this, &IntegrationPluginUniPi::configValueChanged, this, &IntegrationPluginUniPi::onPluginConfigurationChanged);
     //QLoggingCategory::setFilterRules(QStringLiteral("qt.modbus* = false"));
 
+    m_analogPublishTimer = new QTimer(this);
+    m_analogPublishTimer->setSingleShot(true);
+    connect(m_analogPublishTimer, &QTimer::timeout, this, &IntegrationPluginUniPi::onAnalogPublishTimer);
+
+    // Last known circuit values, restored to the things during setup
+    m_ioSnapshotFileName = QDir(NymeaSettings::storagePath()).filePath("unipi-io-snapshot.dat");
+    if (m_ioSnapshot.load(m_ioSnapshotFileName))
+        qCDebug(dcUniPi()) << "Loaded I/O snapshot" << m_ioSnapshotFileName;
+    m_snapshotTimer = new QTimer(this);
+    m_snapshotTimer->setInterval(60000);
+    connect(m_snapshotTimer, &QTimer::timeout, this, &IntegrationPluginUniPi::onSnapshotTimer);
+    m_snapshotTimer->start();
+
     m_connectionStateTypeIds.insert(uniPi1ThingClassId, uniPi1ConnectedStateTypeId);
     m_connectionStateTypeIds.insert(uniPi1LiteThingClassId, uniPi1LiteConnectedStateTypeId);
     m_connectionStateTypeIds.insert(neuronS103ThingClassId, neuronS103ConnectedStateTypeId);
@@ -66,6 +96,108 @@ void IntegrationPluginUniPi::init()
     m_connectionStateTypeIds.insert(neuronXS50ThingClassId, neuronXS50ConnectedStateTypeId);
     m_connectionStateTypeIds.insert(neuronXS11ThingClassId, neuronXS11ConnectedStateTypeId);
     m_connectionStateTypeIds.insert(neuronXS51ThingClassId, neuronXS51ConnectedStateTypeId);
+
+    m_setDigitalOutputsActionTypeIds.insert(neuronS103ThingClassId, neuronS103SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronM103ThingClassId, neuronM103SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronM203ThingClassId, neuronM203SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronM303ThingClassId, neuronM303SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronM403ThingClassId, neuronM403SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronM503ThingClassId, neuronM503SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronL203ThingClassId, neuronL203SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronL303ThingClassId, neuronL303SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronL403ThingClassId, neuronL403SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronL503ThingClassId, neuronL503SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronL513ThingClassId, neuronL513SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronXS10ThingClassId, neuronXS10SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronXS20ThingClassId, neuronXS20SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronXS30ThingClassId, neuronXS30SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronXS40ThingClassId, neuronXS40SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronXS50ThingClassId, neuronXS50SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronXS11ThingClassId, neuronXS11SetDigitalOutputsActionTypeId);
+    m_setDigitalOutputsActionTypeIds.insert(neuronXS51ThingClassId, neuronXS51SetDigitalOutputsActionTypeId);
+
+    m_setDigitalOutputsParamTypeIds.insert(neuronS103ThingClassId, neuronS103SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronM103ThingClassId, neuronM103SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronM203ThingClassId, neuronM203SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronM303ThingClassId, neuronM303SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronM403ThingClassId, neuronM403SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronM503ThingClassId, neuronM503SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronL203ThingClassId, neuronL203SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronL303ThingClassId, neuronL303SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronL403ThingClassId, neuronL403SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronL503ThingClassId, neuronL503SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronL513ThingClassId, neuronL513SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronXS10ThingClassId, neuronXS10SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronXS20ThingClassId, neuronXS20SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronXS30ThingClassId, neuronXS30SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronXS40ThingClassId, neuronXS40SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronXS50ThingClassId, neuronXS50SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronXS11ThingClassId, neuronXS11SetDigitalOutputsActionOutputsParamTypeId);
+    m_setDigitalOutputsParamTypeIds.insert(neuronXS51ThingClassId, neuronXS51SetDigitalOutputsActionOutputsParamTypeId);
+
+    m_watchdogResetEventTypeIds.insert(neuronS103ThingClassId, neuronS103WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronM103ThingClassId, neuronM103WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronM203ThingClassId, neuronM203WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronM303ThingClassId, neuronM303WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronM403ThingClassId, neuronM403WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronM503ThingClassId, neuronM503WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronL203ThingClassId, neuronL203WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronL303ThingClassId, neuronL303WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronL403ThingClassId, neuronL403WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronL503ThingClassId, neuronL503WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronL513ThingClassId, neuronL513WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronXS10ThingClassId, neuronXS10WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronXS20ThingClassId, neuronXS20WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronXS30ThingClassId, neuronXS30WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronXS40ThingClassId, neuronXS40WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronXS50ThingClassId, neuronXS50WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronXS11ThingClassId, neuronXS11WatchdogResetEventTypeId);
+    m_watchdogResetEventTypeIds.insert(neuronXS51ThingClassId, neuronXS51WatchdogResetEventTypeId);
+
+    m_liveStateTypeIds.insert(digitalInputThingClassId, digitalInputLiveStateTypeId);
+    m_liveStateTypeIds.insert(digitalOutputThingClassId, digitalOutputLiveStateTypeId);
+    m_liveStateTypeIds.insert(analogInputThingClassId, analogInputLiveStateTypeId);
+    m_liveStateTypeIds.insert(analogOutputThingClassId, analogOutputLiveStateTypeId);
+    m_liveStateTypeIds.insert(userLEDThingClassId, userLEDLiveStateTypeId);
+    m_liveStateTypeIds.insert(pwmOutputThingClassId, pwmOutputLiveStateTypeId);
+
+    m_reconnectAttemptStateTypeIds.insert(neuronS103ThingClassId, neuronS103ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronM103ThingClassId, neuronM103ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronM203ThingClassId, neuronM203ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronM303ThingClassId, neuronM303ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronM403ThingClassId, neuronM403ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronM503ThingClassId, neuronM503ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronL203ThingClassId, neuronL203ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronL303ThingClassId, neuronL303ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronL403ThingClassId, neuronL403ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronL503ThingClassId, neuronL503ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronL513ThingClassId, neuronL513ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronXS10ThingClassId, neuronXS10ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronXS20ThingClassId, neuronXS20ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronXS30ThingClassId, neuronXS30ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronXS40ThingClassId, neuronXS40ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronXS50ThingClassId, neuronXS50ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronXS11ThingClassId, neuronXS11ReconnectAttemptStateTypeId);
+    m_reconnectAttemptStateTypeIds.insert(neuronXS51ThingClassId, neuronXS51ReconnectAttemptStateTypeId);
+
+    m_nextReconnectStateTypeIds.insert(neuronS103ThingClassId, neuronS103NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronM103ThingClassId, neuronM103NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronM203ThingClassId, neuronM203NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronM303ThingClassId, neuronM303NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronM403ThingClassId, neuronM403NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronM503ThingClassId, neuronM503NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronL203ThingClassId, neuronL203NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronL303ThingClassId, neuronL303NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronL403ThingClassId, neuronL403NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronL503ThingClassId, neuronL503NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronL513ThingClassId, neuronL513NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronXS10ThingClassId, neuronXS10NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronXS20ThingClassId, neuronXS20NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronXS30ThingClassId, neuronXS30NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronXS40ThingClassId, neuronXS40NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronXS50ThingClassId, neuronXS50NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronXS11ThingClassId, neuronXS11NextReconnectStateTypeId);
+    m_nextReconnectStateTypeIds.insert(neuronXS51ThingClassId, neuronXS51NextReconnectStateTypeId);
 }
 
 void IntegrationPluginUniPi::discoverThings(ThingDiscoveryInfo *info)
@@ -338,6 +470,26 @@ void IntegrationPluginUniPi::discoverThings(ThingDiscoveryInfo *info)
             }
         }
         return info->finish(Thing::ThingErrorNoError);
+    } else if (ThingClassId == pwmOutputThingClassId) {
+        // Only the Neuron group 1 digital outputs have a PWM generator, extensions have none
+        foreach (Neuron *neuron, m_neurons) {
+            ThingId parentId = m_neurons.key(neuron);
+            foreach (QString circuit, neuron->pwmOutputs()) {
+                ThingDescriptor ThingDescriptor(pwmOutputThingClassId, QString("PWM output %1").arg(circuit), QString("Neuron %1").arg(neuron->type()), parentId);
+                foreach(Thing *thing, myThings().filterByParentId(m_neurons.key(neuron))) {
+                    if (thing->paramValue(pwmOutputThingCircuitParamTypeId) == circuit) {
+                        qCDebug(dcUniPi()) << "Found already added Circuit:" << circuit << parentId;
+                        ThingDescriptor.setThingId(thing->id());
+                        break;
+                    }
+                }
+                ParamList params;
+                params.append(Param(pwmOutputThingCircuitParamTypeId, circuit));
+                ThingDescriptor.setParams(params);
+                info->addThingDescriptor(ThingDescriptor);
+            }
+        }
+        return info->finish(Thing::ThingErrorNoError);
     } else {
         qCWarning(dcUniPi()) << "Unhandled Thing class in discoverThing" << ThingClassId;
         return info->finish(Thing::ThingErrorThingClassNotFound);
@@ -389,46 +541,50 @@ void IntegrationPluginUniPi::setupThing(ThingSetupInfo *info)
 
         Neuron *neuron;
         if (thing->thingClassId() == neuronS103ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::S103, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::S103, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else  if (thing->thingClassId() == neuronM103ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::M103, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::M103, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronM203ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::M203, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::M203, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronM303ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::M303, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::M303, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronM403ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::M403, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::M403, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronM503ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::M503, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::M503, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronL203ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::L203, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::L203, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronL303ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::L303, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::L303, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronL403ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::L403, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::L403, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else if (thing->thingClassId() == neuronL503ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::L503, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::L503, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else  if (thing->thingClassId() == neuronL513ThingClassId) {
-            neuron = new Neuron(Neuron::NeuronTypes::L513, m_modbusTCPMaster, this);
+            neuron = new Neuron(Neuron::NeuronTypes::L513, m_modbusTCPMaster, &m_modbusTCPRttEstimator, m_modbusTCPTimeoutWheel, m_modbusTCPTransactionWindow, this);
         } else {
             return info->finish(Thing::ThingErrorSetupFailed, QT_TR_NOOP("Error unrecognized Neuron type."));
         }
 
+        neuron->setReadGapTolerance(configValue(uniPiPluginReadGapToleranceParamTypeId).toInt());
+        neuron->setPackedDigitalPolling(configValue(uniPiPluginPackedDigitalPollingParamTypeId).toBool());
+        neuron->setAnalogWordOrder(analogWordOrder(configValue(uniPiPluginAnalogWordOrderParamTypeId)));
+        neuron->setCounterPollingInterval(configValue(uniPiPluginCounterPollIntervalParamTypeId).toInt());
         if (!neuron->init()) {
             qCWarning(dcUniPi()) << "Could not load the modbus map";
             neuron->deleteLater();
             neuron = nullptr;
             return info->finish(Thing::ThingErrorSetupFailed, QT_TR_NOOP("Error setting up Neuron Thing."));
         }
+        neuron->setWatchdogTimeout(configValue(uniPiPluginWatchdogTimeoutParamTypeId).toInt());
+        neuron->setPwmFrequency(configValue(uniPiPluginPwmFrequencyParamTypeId).toDouble());
         m_neurons.insert(thing->id(), neuron);
+        m_neuronThingIds.insert(neuron, thing->id());
+        updateReconnectStates();
         connect(neuron, &Neuron::requestExecuted, this, &IntegrationPluginUniPi::onRequestExecuted);
         connect(neuron, &Neuron::requestError, this, &IntegrationPluginUniPi::onRequestError);
         connect(neuron, &Neuron::connectionStateChanged, this, &IntegrationPluginUniPi::onNeuronConnectionStateChanged);
-        connect(neuron, &Neuron::digitalInputStatusChanged, this, &IntegrationPluginUniPi::onNeuronDigitalInputStatusChanged);
-        connect(neuron, &Neuron::digitalOutputStatusChanged, this, &IntegrationPluginUniPi::onNeuronDigitalOutputStatusChanged);
-        connect(neuron, &Neuron::analogInputStatusChanged, this, &IntegrationPluginUniPi::onNeuronAnalogInputStatusChanged);
-        connect(neuron, &Neuron::analogOutputStatusChanged, this, &IntegrationPluginUniPi::onNeuronAnalogOutputStatusChanged);
-        connect(neuron, &Neuron::userLEDStatusChanged, this, &IntegrationPluginUniPi::onNeuronUserLEDStatusChanged);
+        connect(neuron, &Neuron::ioChanged, this, &IntegrationPluginUniPi::onNeuronIoChanged);
 
         thing->setStateValue(m_connectionStateTypeIds.value(thing->thingClassId()), (m_modbusTCPMaster->state() == QModbusDevice::ConnectedState));
 
@@ -449,56 +605,75 @@ void IntegrationPluginUniPi::setupThing(ThingSetupInfo *info)
 
         if(thing->thingClassId() == neuronXS10ThingClassId) {
             slaveAddress = thing->paramValue(neuronXS10ThingSlaveAddressParamTypeId).toInt();
-            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS10, m_modbusRTUMaster, slaveAddress, this);
+            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS10, m_neuronExtensionBus, slaveAddress, this);
         } else if (thing->thingClassId() == neuronXS20ThingClassId) {
             slaveAddress = thing->paramValue(neuronXS20ThingSlaveAddressParamTypeId).toInt();
-            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS20, m_modbusRTUMaster, slaveAddress, this);
+            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS20, m_neuronExtensionBus, slaveAddress, this);
         } else if (thing->thingClassId() == neuronXS30ThingClassId) {
             slaveAddress = thing->paramValue(neuronXS30ThingSlaveAddressParamTypeId).toInt();
-            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS30, m_modbusRTUMaster, slaveAddress, this);
+            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS30, m_neuronExtensionBus, slaveAddress, this);
         } else if (thing->thingClassId() == neuronXS40ThingClassId) {
             slaveAddress = thing->paramValue(neuronXS40ThingSlaveAddressParamTypeId).toInt();
-            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS40, m_modbusRTUMaster, slaveAddress, this);
+            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS40, m_neuronExtensionBus, slaveAddress, this);
         } else if (thing->thingClassId() == neuronXS50ThingClassId) {
             slaveAddress = thing->paramValue(neuronXS50ThingSlaveAddressParamTypeId).toInt();
-            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS50, m_modbusRTUMaster, slaveAddress, this);
+            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS50, m_neuronExtensionBus, slaveAddress, this);
         } else if (thing->thingClassId() == neuronXS11ThingClassId) {
             slaveAddress = thing->paramValue(neuronXS11ThingSlaveAddressParamTypeId).toInt();
-            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS11, m_modbusRTUMaster, slaveAddress, this);
+            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS11, m_neuronExtensionBus, slaveAddress, this);
         } else if (thing->thingClassId() == neuronXS51ThingClassId) {
             slaveAddress = thing->paramValue(neuronXS51ThingSlaveAddressParamTypeId).toInt();
-            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS51, m_modbusRTUMaster, slaveAddress, this);
+            neuronExtension = new NeuronExtension(NeuronExtension::ExtensionTypes::xS51, m_neuronExtensionBus, slaveAddress, this);
         } else {
             return info->finish(Thing::ThingErrorSetupFailed, QT_TR_NOOP("Error unrecognized extension type."));
         }
+        neuronExtension->setReadGapTolerance(configValue(uniPiPluginReadGapToleranceParamTypeId).toInt());
+        neuronExtension->setPackedDigitalPolling(configValue(uniPiPluginPackedDigitalPollingParamTypeId).toBool());
+        neuronExtension->setAnalogWordOrder(analogWordOrder(configValue(uniPiPluginAnalogWordOrderParamTypeId)));
         if (!neuronExtension->init()) {
             qCWarning(dcUniPi()) << "Could not load the modbus map";
             neuronExtension->deleteLater();
             neuronExtension = nullptr;
             return info->finish(Thing::ThingErrorSetupFailed, QT_TR_NOOP("Error loading modbus map."));
         }
+        neuronExtension->setWatchdogTimeout(configValue(uniPiPluginWatchdogTimeoutParamTypeId).toInt());
         connect(neuronExtension, &NeuronExtension::requestExecuted, this, &IntegrationPluginUniPi::onRequestExecuted);
         connect(neuronExtension, &NeuronExtension::requestError, this, &IntegrationPluginUniPi::onRequestError);
         connect(neuronExtension, &NeuronExtension::connectionStateChanged, this, &IntegrationPluginUniPi::onNeuronExtensionConnectionStateChanged);
-        connect(neuronExtension, &NeuronExtension::digitalInputStatusChanged, this, &IntegrationPluginUniPi::onNeuronExtensionDigitalInputStatusChanged);
-        connect(neuronExtension, &NeuronExtension::digitalOutputStatusChanged, this, &IntegrationPluginUniPi::onNeuronExtensionDigitalOutputStatusChanged);
-        connect(neuronExtension, &NeuronExtension::analogInputStatusChanged, this, &IntegrationPluginUniPi::onNeuronExtensionAnalogInputStatusChanged);
-        connect(neuronExtension, &NeuronExtension::analogOutputStatusChanged, this, &IntegrationPluginUniPi::onNeuronExtensionAnalogOutputStatusChanged);
-        connect(neuronExtension, &NeuronExtension::userLEDStatusChanged, this, &IntegrationPluginUniPi::onNeuronExtensionUserLEDStatusChanged);
+        connect(neuronExtension, &NeuronExtension::ioChanged, this, &IntegrationPluginUniPi::onNeuronExtensionIoChanged);
 
         m_neuronExtensions.insert(thing->id(), neuronExtension);
+        m_neuronExtensionThingIds.insert(neuronExtension, thing->id());
+        updateReconnectStates();
         thing->setStateValue(m_connectionStateTypeIds.value(thing->thingClassId()), (m_modbusRTUMaster->state() == QModbusDevice::ConnectedState));
 
         return info->finish(Thing::ThingErrorNoError);
     } else if (thing->thingClassId() == digitalOutputThingClassId) {
+        indexCircuitThing(thing);
+        restoreSnapshot(thing);
         return info->finish(Thing::ThingErrorNoError);
     } else if (thing->thingClassId() == digitalInputThingClassId) {
+        m_counterSamples.remove(thing->id());
+        indexCircuitThing(thing);
+        restoreSnapshot(thing);
+        configureDigitalInput(thing);
         return info->finish(Thing::ThingErrorNoError);
     } else if (thing->thingClassId() == userLEDThingClassId) {
+        indexCircuitThing(thing);
+        restoreSnapshot(thing);
+        return info->finish(Thing::ThingErrorNoError);
+    } else if (thing->thingClassId() == pwmOutputThingClassId) {
+        indexCircuitThing(thing);
+        restoreSnapshot(thing);
         return info->finish(Thing::ThingErrorNoError);
     } else if (thing->thingClassId() == analogInputThingClassId) {
+        m_analogInputFilters.remove(thing->id());
+        indexCircuitThing(thing);
+        restoreSnapshot(thing);
         return info->finish(Thing::ThingErrorNoError);
     } else if (thing->thingClassId() == analogOutputThingClassId) {
+        indexCircuitThing(thing);
+        restoreSnapshot(thing);
         return info->finish(Thing::ThingErrorNoError);
     } else {
         qCWarning(dcUniPi()) << "Unhandled Thing class in setupThing:" << thing->thingClassId();
@@ -509,12 +684,6 @@ void IntegrationPluginUniPi::setupThing(ThingSetupInfo *info)
 void IntegrationPluginUniPi::postSetupThing(Thing *thing)
 {
     Q_UNUSED(thing)
-
-    if (!m_reconnectTimer) {
-        m_reconnectTimer = new QTimer(this);
-        m_reconnectTimer->setSingleShot(true);
-        connect(m_reconnectTimer, &QTimer::timeout, this, &IntegrationPluginUniPi::onReconnectTimer);
-    }
 }
 
 
@@ -523,6 +692,47 @@ void IntegrationPluginUniPi::executeAction(ThingActionInfo *info)
     Thing *thing = info->thing();
     Action action = info->action();
 
+    if (m_setDigitalOutputsActionTypeIds.contains(thing->thingClassId()) && action.actionTypeId() == m_setDigitalOutputsActionTypeIds.value(thing->thingClassId())) {
+        QString outputs = action.param(m_setDigitalOutputsParamTypeIds.value(thing->thingClassId())).value().toString();
+
+        QList<QString> circuits;
+        if (m_neurons.contains(thing->id())) {
+            circuits = m_neurons.value(thing->id())->digitalOutputs();
+        } else if (m_neuronExtensions.contains(thing->id())) {
+            circuits = m_neuronExtensions.value(thing->id())->digitalOutputs();
+        } else {
+            return info->finish(Thing::ThingErrorHardwareNotAvailable);
+        }
+
+        QHash<QString, bool> values;
+        foreach (const QString &entry, outputs.split(QRegExp("[,;]"), QString::SkipEmptyParts)) {
+            QStringList pair = entry.split("=");
+            if (pair.length() != 2 || !circuits.contains(pair.at(0).trimmed())) {
+                qCWarning(dcUniPi()) << "Invalid digital output setting" << entry;
+                return info->finish(Thing::ThingErrorInvalidParameter, QT_TR_NOOP("Outputs must be given as circuit=value pairs of existing digital outputs."));
+            }
+            QString value = pair.at(1).trimmed().toLower();
+            values.insert(pair.at(0).trimmed(), (value == "1" || value == "true" || value == "on"));
+        }
+
+        if (values.isEmpty()) {
+            return info->finish(Thing::ThingErrorInvalidParameter, QT_TR_NOOP("No digital outputs given."));
+        }
+
+        QUuid requestId;
+        if (m_neurons.contains(thing->id())) {
+            requestId = m_neurons.value(thing->id())->setDigitalOutputs(values);
+        } else {
+            requestId = m_neuronExtensions.value(thing->id())->setDigitalOutputs(values);
+        }
+        if (requestId.isNull()) {
+            return info->finish(Thing::ThingErrorHardwareFailure);
+        }
+        m_asyncActions.insert(requestId, info);
+        connect(info, &ThingActionInfo::aborted, this, [requestId, this](){m_asyncActions.remove(requestId);});
+        return;
+    }
+
     if (thing->thingClassId() == digitalOutputThingClassId)  {
 
         if (action.actionTypeId() == digitalOutputPowerActionTypeId) {
@@ -635,6 +845,31 @@ void IntegrationPluginUniPi::executeAction(ThingActionInfo *info)
             qCWarning(dcUniPi()) << "Unhandled ActionTypeId" << action.actionTypeId();
             return info->finish(Thing::ThingErrorActionTypeNotFound);
         }
+    } else if (thing->thingClassId() == pwmOutputThingClassId) {
+        QString pwmOutput = thing->paramValue(pwmOutputThingCircuitParamTypeId).toString();
+        double dutyCycle;
+        if (action.actionTypeId() == pwmOutputPowerActionTypeId) {
+            bool power = action.param(pwmOutputPowerActionPowerParamTypeId).value().toBool();
+            dutyCycle = power ? m_pwmOnDutyCycles.value(thing->id(), 100) : 0;
+        } else if (action.actionTypeId() == pwmOutputDutyCycleActionTypeId) {
+            dutyCycle = action.param(pwmOutputDutyCycleActionDutyCycleParamTypeId).value().toDouble();
+        } else {
+            qCWarning(dcUniPi()) << "Unhandled ActionTypeId" << action.actionTypeId();
+            return info->finish(Thing::ThingErrorActionTypeNotFound);
+        }
+        if (!m_neurons.contains(thing->parentId())) {
+            qCWarning(dcUniPi()) << "Hardware not initilized" << thing->name();
+            return info->finish(Thing::ThingErrorHardwareFailure);
+        }
+        Neuron *neuron = m_neurons.value(thing->parentId());
+        QUuid requestId = neuron->setPwmDutyCycle(pwmOutput, dutyCycle);
+        if (requestId.isNull()) {
+            info->finish(Thing::ThingErrorHardwareFailure);
+        } else {
+            m_asyncActions.insert(requestId, info);
+            connect(info, &ThingActionInfo::aborted, this, [requestId, this](){m_asyncActions.remove(requestId);});
+        }
+        return;
     } else {
         qCWarning(dcUniPi()) << "Unhandled Thing class in executeAction" << thing->thingClassId();
         info->finish(Thing::ThingErrorThingClassNotFound);
@@ -644,11 +879,22 @@ void IntegrationPluginUniPi::executeAction(ThingActionInfo *info)
 
 void IntegrationPluginUniPi::thingRemoved(Thing *thing)
 {
+    if (m_circuitThings.contains(thing->parentId())) {
+        m_circuitThings[thing->parentId()].remove(circuitKey(thing));
+    }
+    m_circuitThings.remove(thing->id());
+    m_analogInputFilters.remove(thing->id());
+    m_counterSamples.remove(thing->id());
+    m_pwmOnDutyCycles.remove(thing->id());
+    m_ioSnapshot.removeDevice(thing->id());
+
     if(m_neurons.contains(thing->id())) {
         Neuron *neuron = m_neurons.take(thing->id());
+        m_neuronThingIds.remove(neuron);
         neuron->deleteLater();
     } else if(m_neuronExtensions.contains(thing->id())) {
         NeuronExtension *neuronExtension = m_neuronExtensions.take(thing->id());
+        m_neuronExtensionThingIds.remove(neuronExtension);
         neuronExtension->deleteLater();
     } else if ((thing->thingClassId() == uniPi1ThingClassId) || (thing->thingClassId() == uniPi1LiteThingClassId)) {
         if(m_unipi) {
@@ -658,20 +904,21 @@ void IntegrationPluginUniPi::thingRemoved(Thing *thing)
     }
 
     if (myThings().isEmpty()) {
-        if (m_reconnectTimer) {
-            m_reconnectTimer->stop();
-            m_reconnectTimer->deleteLater();
-            m_reconnectTimer = nullptr;
-        }
-
         if (m_modbusTCPMaster) {
+            m_modbusTCPReconnector->stop(); // owned by the TCP master
+            m_modbusTCPReconnector = nullptr;
+            m_modbusTCPTimeoutWheel = nullptr; // owned by the TCP master
+            m_modbusTCPTransactionWindow = nullptr;
             m_modbusTCPMaster->disconnectDevice();
             m_modbusTCPMaster->deleteLater();
             m_modbusTCPMaster = nullptr;
         }
-        if (m_modbusRTUMaster) {
+        if (m_neuronExtensionBus) {
+            m_modbusRTUReconnector->stop(); // owned by the RTU master
+            m_modbusRTUReconnector = nullptr;
             m_modbusRTUMaster->disconnectDevice();
-            m_modbusRTUMaster->deleteLater();
+            m_neuronExtensionBus->deleteLater(); // owns the RTU master
+            m_neuronExtensionBus = nullptr;
             m_modbusRTUMaster = nullptr;
         }
     }
@@ -713,6 +960,79 @@ void IntegrationPluginUniPi::onPluginConfigurationChanged(const ParamTypeId &par
             }
         }
     }
+
+    if (paramTypeId == uniPiPluginReadGapToleranceParamTypeId) {
+        foreach (Neuron *neuron, m_neurons) {
+            neuron->setReadGapTolerance(value.toInt());
+        }
+        foreach (NeuronExtension *neuronExtension, m_neuronExtensions) {
+            neuronExtension->setReadGapTolerance(value.toInt());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginPackedDigitalPollingParamTypeId) {
+        foreach (Neuron *neuron, m_neurons) {
+            neuron->setPackedDigitalPolling(value.toBool());
+        }
+        foreach (NeuronExtension *neuronExtension, m_neuronExtensions) {
+            neuronExtension->setPackedDigitalPolling(value.toBool());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginRtuInputPollIntervalParamTypeId) {
+        if (m_neuronExtensionBus) {
+            m_neuronExtensionBus->setInputPollingInterval(value.toInt());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginRtuOutputPollIntervalParamTypeId) {
+        if (m_neuronExtensionBus) {
+            m_neuronExtensionBus->setOutputPollingInterval(value.toInt());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginTransactionWindowParamTypeId) {
+        if (m_modbusTCPTransactionWindow) {
+            m_modbusTCPTransactionWindow->setSize(value.toInt());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginCounterPollIntervalParamTypeId) {
+        foreach (Neuron *neuron, m_neurons) {
+            neuron->setCounterPollingInterval(value.toInt());
+        }
+        if (m_neuronExtensionBus) {
+            m_neuronExtensionBus->setCounterPollingInterval(value.toInt());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginWatchdogTimeoutParamTypeId) {
+        // The watchdog is fed by the polls, the slowest poll cycle has to fit in comfortably
+        int slowestPollInterval = qMax(1000, configValue(uniPiPluginRtuOutputPollIntervalParamTypeId).toInt());
+        if (value.toInt() > 0 && value.toInt() < 2 * slowestPollInterval)
+            qCWarning(dcUniPi()) << "Watchdog timeout" << value.toInt() << "ms is shorter than two output poll cycles, outputs may be reset while nymea is running";
+        foreach (Neuron *neuron, m_neurons) {
+            neuron->setWatchdogTimeout(value.toInt());
+        }
+        foreach (NeuronExtension *neuronExtension, m_neuronExtensions) {
+            neuronExtension->setWatchdogTimeout(value.toInt());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginPwmFrequencyParamTypeId) {
+        foreach (Neuron *neuron, m_neurons) {
+            neuron->setPwmFrequency(value.toDouble());
+        }
+    }
+
+    if (paramTypeId == uniPiPluginAnalogWordOrderParamTypeId) {
+        foreach (Neuron *neuron, m_neurons) {
+            neuron->setAnalogWordOrder(analogWordOrder(value));
+        }
+        foreach (NeuronExtension *neuronExtension, m_neuronExtensions) {
+            neuronExtension->setAnalogWordOrder(analogWordOrder(value));
+        }
+    }
 }
 
 void IntegrationPluginUniPi::onNeuronConnectionStateChanged(bool state)
@@ -726,137 +1046,264 @@ void IntegrationPluginUniPi::onNeuronConnectionStateChanged(bool state)
     thing->setStateValue(m_connectionStateTypeIds.value(thing->thingClassId()), state);
 }
 
-void IntegrationPluginUniPi::onNeuronDigitalInputStatusChanged(const QString &circuit, bool value)
+void IntegrationPluginUniPi::onNeuronIoChanged(const IoChangeSet &changeSet)
 {
     Neuron *neuron = static_cast<Neuron *>(sender());
-
-    foreach(Thing *thing, myThings().filterByParentId(m_neurons.key(neuron))) {
-        if (thing->thingClassId() == digitalInputThingClassId) {
-            if (thing->paramValue(digitalInputThingCircuitParamTypeId).toString() == circuit) {
-
-                thing->setStateValue(digitalInputInputStatusStateTypeId, value);
-                return;
-            }
-        }
-    }
+    applyIoChanges(m_neuronThingIds.value(neuron), changeSet);
 }
 
-void IntegrationPluginUniPi::onNeuronExtensionDigitalInputStatusChanged(const QString &circuit, bool value)
+void IntegrationPluginUniPi::onNeuronExtensionIoChanged(const IoChangeSet &changeSet)
 {
     NeuronExtension *neuronExtension = static_cast<NeuronExtension *>(sender());
+    applyIoChanges(m_neuronExtensionThingIds.value(neuronExtension), changeSet);
+}
 
-    foreach(Thing *thing, myThings().filterByParentId(m_neuronExtensions.key(neuronExtension))) {
-        if (thing->thingClassId() == digitalInputThingClassId) {
-            if (thing->paramValue(digitalInputThingCircuitParamTypeId).toString() == circuit) {
-
-                thing->setStateValue(digitalInputInputStatusStateTypeId, value);
-                return;
-            }
+void IntegrationPluginUniPi::applyIoChanges(const ThingId &parentId, const IoChangeSet &changeSet)
+{
+    const QHash<QPair<int, QString>, Thing *> circuitThings = m_circuitThings.value(parentId);
+    foreach (const IoChange &change, changeSet.changes) {
+        if (change.type == ModbusRegisterTable::WatchdogReset) {
+            Thing *parent = myThings().findById(parentId);
+            if (parent)
+                emit emitEvent(Event(m_watchdogResetEventTypeIds.value(parent->thingClassId()), parentId));
+            continue;
+        }
+        m_ioSnapshot.setValue(parentId, change.type, change.circuit, change.value);
+
+        // Counters belong to the digital input thing of the same circuit
+        ModbusRegisterTable::CircuitType thingType = change.type;
+        if (thingType == ModbusRegisterTable::DigitalInputCounter)
+            thingType = ModbusRegisterTable::DigitalInput;
+
+        Thing *thing = circuitThings.value(qMakePair(static_cast<int>(thingType), change.circuit));
+        if (!thing)
+            continue;
+        thing->setStateValue(m_liveStateTypeIds.value(thing->thingClassId()), true);
+
+        switch (change.type) {
+        case ModbusRegisterTable::DigitalInput:
+            thing->setStateValue(digitalInputInputStatusStateTypeId, change.value != 0.0);
+            break;
+        case ModbusRegisterTable::DigitalOutput:
+            thing->setStateValue(digitalOutputPowerStateTypeId, change.value != 0.0);
+            break;
+        case ModbusRegisterTable::AnalogInput:
+            publishAnalogInput(thing, change.value, changeSet.timestamp);
+            break;
+        case ModbusRegisterTable::AnalogOutput:
+            thing->setStateValue(analogOutputOutputValueStateTypeId, change.value);
+            break;
+        case ModbusRegisterTable::UserLED:
+            thing->setStateValue(userLEDPowerStateTypeId, change.value != 0.0);
+            break;
+        case ModbusRegisterTable::PwmOutput:
+            if (change.value > 0)
+                m_pwmOnDutyCycles.insert(thing->id(), change.value);
+            thing->setStateValue(pwmOutputDutyCycleStateTypeId, change.value);
+            thing->setStateValue(pwmOutputPowerStateTypeId, change.value > 0);
+            break;
+        case ModbusRegisterTable::DigitalInputCounter:
+            updatePulseCounter(thing, static_cast<quint32>(change.value), changeSet.timestamp);
+            break;
+        case ModbusRegisterTable::WatchdogReset:
+        case ModbusRegisterTable::NoCircuit:
+            break;
         }
     }
 }
 
-void IntegrationPluginUniPi::onNeuronDigitalOutputStatusChanged(const QString &circuit, bool value)
+void IntegrationPluginUniPi::publishAnalogInput(Thing *thing, double value, qint64 timestamp)
 {
-    Neuron *neuron = static_cast<Neuron *>(sender());
-
-    foreach(Thing *thing, myThings().filterByParentId(m_neurons.key(neuron))) {
-        if (thing->thingClassId() == digitalOutputThingClassId) {
-            if (thing->paramValue(digitalOutputThingCircuitParamTypeId).toString() == circuit) {
+    AnalogInputFilter &filter = m_analogInputFilters[thing->id()];
+    if (filter.published) {
+        // Drop ADC noise around the last published value
+        double published = thing->stateValue(analogInputInputValueStateTypeId).toDouble();
+        double deadband = qMax(thing->paramValue(analogInputThingDeadbandAbsoluteParamTypeId).toDouble(),
+                               qAbs(published) * thing->paramValue(analogInputThingDeadbandRelativeParamTypeId).toDouble() / 100.0);
+        if (qAbs(value - published) <= deadband) {
+            filter.pending = false;
+            return;
+        }
 
-                thing->setStateValue(digitalOutputPowerStateTypeId, value);
-                return;
-            }
+        // Hold back the latest value until the minimum publish interval has passed
+        qint64 wait = filter.lastPublished + thing->paramValue(analogInputThingMinPublishIntervalParamTypeId).toLongLong() - timestamp;
+        if (wait > 0) {
+            filter.pending = true;
+            filter.pendingValue = value;
+            if (!m_analogPublishTimer->isActive() || m_analogPublishTimer->remainingTime() > wait)
+                m_analogPublishTimer->start(static_cast<int>(wait));
+            return;
         }
     }
+
+    thing->setStateValue(analogInputInputValueStateTypeId, value);
+    filter.published = true;
+    filter.lastPublished = timestamp;
+    filter.pending = false;
 }
 
-void IntegrationPluginUniPi::onNeuronExtensionDigitalOutputStatusChanged(const QString &circuit, bool value)
+void IntegrationPluginUniPi::configureDigitalInput(Thing *thing)
 {
-    NeuronExtension *neuronExtension = static_cast<NeuronExtension *>(sender());
-
-    foreach(Thing *thing, myThings().filterByParentId(m_neuronExtensions.key(neuronExtension))) {
-        if (thing->thingClassId() == digitalOutputThingClassId) {
-            if (thing->paramValue(digitalOutputThingCircuitParamTypeId).toString() == circuit) {
-
-                thing->setStateValue(digitalOutputPowerStateTypeId, value);
-                return;
-            }
+    // Debounce filter and DirectSwitch run on the Neuron MCU, the UniPi 1 has neither
+    QString circuit = thing->paramValue(digitalInputThingCircuitParamTypeId).toString();
+    double debounceTime = thing->paramValue(digitalInputThingDebounceTimeParamTypeId).toDouble();
+    QString directSwitch = thing->paramValue(digitalInputThingDirectSwitchParamTypeId).toString();
+    bool inverted = thing->paramValue(digitalInputThingDirectSwitchInvertedParamTypeId).toBool();
+    bool keepDirectSwitch = (directSwitch == "Keep device setting");
+    bool debounceSupported = false;
+    bool directSwitchSupported = false;
+    if (m_neurons.contains(thing->parentId())) {
+        Neuron *neuron = m_neurons.value(thing->parentId());
+        debounceSupported = neuron->setDigitalInputDebounceTime(circuit, debounceTime);
+        if (keepDirectSwitch) {
+            directSwitchSupported = neuron->resetDigitalInputDirectSwitch(circuit);
+        } else {
+            directSwitchSupported = neuron->setDigitalInputDirectSwitch(circuit, directSwitch != "Off", directSwitch == "Toggle", inverted);
+        }
+    } else if (m_neuronExtensions.contains(thing->parentId())) {
+        NeuronExtension *neuronExtension = m_neuronExtensions.value(thing->parentId());
+        debounceSupported = neuronExtension->setDigitalInputDebounceTime(circuit, debounceTime);
+        if (keepDirectSwitch) {
+            directSwitchSupported = neuronExtension->resetDigitalInputDirectSwitch(circuit);
+        } else {
+            directSwitchSupported = neuronExtension->setDigitalInputDirectSwitch(circuit, directSwitch != "Off", directSwitch == "Toggle", inverted);
         }
     }
+    if (!debounceSupported && debounceTime > 0)
+        qCWarning(dcUniPi()) << "Debounce time is not supported on digital input" << circuit;
+    if (!directSwitchSupported && !keepDirectSwitch)
+        qCWarning(dcUniPi()) << "DirectSwitch is not supported on digital input" << circuit;
 }
 
-void IntegrationPluginUniPi::onNeuronAnalogInputStatusChanged(const QString &circuit, double value)
+void IntegrationPluginUniPi::updatePulseCounter(Thing *thing, quint32 count, qint64 timestamp)
 {
-    Neuron *neuron = static_cast<Neuron *>(sender());
-
-    foreach(Thing *thing, myThings().filterByParentId(m_neurons.key(neuron))) {
-        if (thing->thingClassId() == analogInputThingClassId) {
-            if (thing->paramValue(analogInputThingCircuitParamTypeId).toString() == circuit) {
-
-                thing->setStateValue(analogInputInputValueStateTypeId, value);
-                return;
-            }
-        }
+    CounterSample &sample = m_counterSamples[thing->id()];
+    if (sample.valid && timestamp > sample.timestamp) {
+        // Unsigned arithmetic keeps the difference right across the 32 bit wrap around
+        quint32 pulses = count - sample.count;
+        thing->setStateValue(digitalInputPulseRateStateTypeId, pulses * 1000.0 / (timestamp - sample.timestamp));
     }
+    thing->setStateValue(digitalInputCounterStateTypeId, count);
+    sample.valid = true;
+    sample.count = count;
+    sample.timestamp = timestamp;
 }
 
-void IntegrationPluginUniPi::onNeuronExtensionAnalogInputStatusChanged(const QString &circuit, double value)
+void IntegrationPluginUniPi::onAnalogPublishTimer()
 {
-    NeuronExtension *neuronExtension = static_cast<NeuronExtension *>(sender());
-
-    foreach(Thing *thing, myThings().filterByParentId(m_neuronExtensions.key(neuronExtension))) {
-        if (thing->thingClassId() == analogInputThingClassId) {
-            if (thing->paramValue(analogInputThingCircuitParamTypeId).toString() == circuit) {
-                thing->setStateValue(analogInputInputValueStateTypeId, value);
-                return;
-            }
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    foreach (const ThingId &thingId, m_analogInputFilters.keys()) {
+        if (!m_analogInputFilters.value(thingId).pending)
+            continue;
+
+        Thing *thing = myThings().findById(thingId);
+        if (!thing) {
+            m_analogInputFilters.remove(thingId);
+            continue;
         }
+        publishAnalogInput(thing, m_analogInputFilters.value(thingId).pendingValue, now);
     }
 }
 
-void IntegrationPluginUniPi::onNeuronAnalogOutputStatusChanged(const QString &circuit, double value)
+QPair<int, QString> IntegrationPluginUniPi::circuitKey(Thing *thing) const
 {
-    Neuron *neuron = static_cast<Neuron *>(sender());
+    if (thing->thingClassId() == digitalInputThingClassId) {
+        return qMakePair(static_cast<int>(ModbusRegisterTable::DigitalInput), thing->paramValue(digitalInputThingCircuitParamTypeId).toString());
+    } else if (thing->thingClassId() == digitalOutputThingClassId) {
+        return qMakePair(static_cast<int>(ModbusRegisterTable::DigitalOutput), thing->paramValue(digitalOutputThingCircuitParamTypeId).toString());
+    } else if (thing->thingClassId() == analogInputThingClassId) {
+        return qMakePair(static_cast<int>(ModbusRegisterTable::AnalogInput), thing->paramValue(analogInputThingCircuitParamTypeId).toString());
+    } else if (thing->thingClassId() == analogOutputThingClassId) {
+        return qMakePair(static_cast<int>(ModbusRegisterTable::AnalogOutput), thing->paramValue(analogOutputThingCircuitParamTypeId).toString());
+    } else if (thing->thingClassId() == userLEDThingClassId) {
+        return qMakePair(static_cast<int>(ModbusRegisterTable::UserLED), thing->paramValue(userLEDThingCircuitParamTypeId).toString());
+    } else if (thing->thingClassId() == pwmOutputThingClassId) {
+        return qMakePair(static_cast<int>(ModbusRegisterTable::PwmOutput), thing->paramValue(pwmOutputThingCircuitParamTypeId).toString());
+    }
+    return qMakePair(static_cast<int>(ModbusRegisterTable::NoCircuit), QString());
+}
 
-    foreach(Thing *thing, myThings().filterByParentId(m_neurons.key(neuron))) {
-        if (thing->thingClassId() == analogOutputThingClassId) {
-            if (thing->paramValue(analogOutputThingCircuitParamTypeId).toString() == circuit) {
+void IntegrationPluginUniPi::restoreSnapshot(Thing *thing)
+{
+    // Values read before the thing was set up are current, values from the file
+    // are stale until the first live read. Both bypass the analog filter and
+    // give no counter rate.
+    QPair<int, QString> key = circuitKey(thing);
+    double value;
+    bool stale;
+    if (key.first == ModbusRegisterTable::NoCircuit || !m_ioSnapshot.value(thing->parentId(), key.first, key.second, &value, &stale))
+        return;
 
-                thing->setStateValue(analogOutputOutputValueStateTypeId, value);
-                return;
-            }
-        }
+    switch (key.first) {
+    case ModbusRegisterTable::DigitalInput: {
+        thing->setStateValue(digitalInputInputStatusStateTypeId, value != 0.0);
+        double count;
+        if (m_ioSnapshot.value(thing->parentId(), ModbusRegisterTable::DigitalInputCounter, key.second, &count))
+            thing->setStateValue(digitalInputCounterStateTypeId, static_cast<quint32>(count));
+        break;
     }
+    case ModbusRegisterTable::DigitalOutput:
+        thing->setStateValue(digitalOutputPowerStateTypeId, value != 0.0);
+        break;
+    case ModbusRegisterTable::AnalogInput:
+        thing->setStateValue(analogInputInputValueStateTypeId, value);
+        break;
+    case ModbusRegisterTable::AnalogOutput:
+        thing->setStateValue(analogOutputOutputValueStateTypeId, value);
+        break;
+    case ModbusRegisterTable::UserLED:
+        thing->setStateValue(userLEDPowerStateTypeId, value != 0.0);
+        break;
+    case ModbusRegisterTable::PwmOutput:
+        thing->setStateValue(pwmOutputDutyCycleStateTypeId, value);
+        thing->setStateValue(pwmOutputPowerStateTypeId, value > 0);
+        break;
+    default:
+        return;
+    }
+    // A stale value must not look authoritative, the thing is live with the first read
+    thing->setStateValue(m_liveStateTypeIds.value(thing->thingClassId()), !stale);
+    qCDebug(dcUniPi()) << "Restored" << (stale ? "stale" : "current") << "value of" << thing->name() << value << "from the I/O snapshot";
 }
 
-void IntegrationPluginUniPi::onNeuronExtensionAnalogOutputStatusChanged(const QString &circuit, double value)
+void IntegrationPluginUniPi::recordSnapshot(Thing *thing, double value)
 {
-    NeuronExtension *neuronExtension = static_cast<NeuronExtension *>(sender());
-
-    foreach(Thing *thing, myThings().filterByParentId(m_neuronExtensions.key(neuronExtension))) {
-        if (thing->thingClassId() == analogOutputThingClassId) {
-            if (thing->paramValue(analogOutputThingCircuitParamTypeId).toString() == circuit) {
+    QPair<int, QString> key = circuitKey(thing);
+    if (key.first != ModbusRegisterTable::NoCircuit)
+        m_ioSnapshot.setValue(thing->parentId(), key.first, key.second, value);
+    thing->setStateValue(m_liveStateTypeIds.value(thing->thingClassId()), true);
+}
 
-                thing->setStateValue(analogOutputOutputValueStateTypeId, value);
-                return;
-            }
-        }
-    }
+void IntegrationPluginUniPi::onSnapshotTimer()
+{
+    if (m_ioSnapshot.isDirty())
+        m_ioSnapshot.save(m_ioSnapshotFileName);
 }
 
-void IntegrationPluginUniPi::onNeuronUserLEDStatusChanged(const QString &circuit, bool value)
+void IntegrationPluginUniPi::indexCircuitThing(Thing *thing)
 {
-    Neuron *neuron = static_cast<Neuron *>(sender());
+    QPair<int, QString> key = circuitKey(thing);
+    if (key.first == ModbusRegisterTable::NoCircuit)
+        return;
 
-    foreach(Thing *thing, myThings().filterByParentId(m_neurons.key(neuron))) {
-        if (thing->thingClassId() == userLEDThingClassId) {
-            if (thing->paramValue(userLEDThingCircuitParamTypeId).toString() == circuit) {
+    m_circuitThings[thing->parentId()].insert(key, thing);
+}
 
-                thing->setStateValue(userLEDPowerStateTypeId, value);
-                return;
-            }
+void IntegrationPluginUniPi::updateReconnectStates()
+{
+    // The Neurons share the TCP master, the extensions the RTU master
+    foreach (Thing *thing, myThings()) {
+        ModbusReconnector *reconnector = nullptr;
+        if (m_neurons.contains(thing->id())) {
+            reconnector = m_modbusTCPReconnector;
+        } else if (m_neuronExtensions.contains(thing->id())) {
+            reconnector = m_modbusRTUReconnector;
+        } else {
+            continue;
         }
+        QDateTime nextRetry = reconnector ? reconnector->nextRetry() : QDateTime();
+        thing->setStateValue(m_reconnectAttemptStateTypeIds.value(thing->thingClassId()), reconnector ? reconnector->attempt() : 0);
+        thing->setStateValue(m_nextReconnectStateTypeIds.value(thing->thingClassId()), nextRetry.isValid() ? nextRetry.toSecsSinceEpoch() : 0);
     }
 }
 
@@ -891,69 +1338,12 @@ void IntegrationPluginUniPi::onRequestError(const QUuid &requestId, const QStrin
     }
 }
 
-void IntegrationPluginUniPi::onNeuronExtensionUserLEDStatusChanged(const QString &circuit, bool value)
-{
-    NeuronExtension *neuronExtension = static_cast<NeuronExtension *>(sender());
-
-    foreach(Thing *thing, myThings().filterByParentId(m_neuronExtensions.key(neuronExtension))) {
-        if (thing->thingClassId() == userLEDThingClassId) {
-            if (thing->paramValue(userLEDThingCircuitParamTypeId).toString() == circuit) {
-
-                thing->setStateValue(userLEDPowerStateTypeId, value);
-                return;
-            }
-        }
-    }
-}
-
-void IntegrationPluginUniPi::onReconnectTimer()
-{
-    if(m_modbusRTUMaster) {
-        if (!m_modbusRTUMaster->connectDevice()) {
-            qCWarning(dcUniPi()) << "Reconnecing to modbus RTU master failed, trying again in 10 seconds";
-            if (m_reconnectTimer)
-                m_reconnectTimer->start(10000);
-        }
-    }
-    if(m_modbusTCPMaster) {
-        if (!m_modbusTCPMaster->connectDevice()) {
-            qCWarning(dcUniPi()) << "Reconnecing to modbus TCP master failed, trying again in 10 seconds";
-            if (m_reconnectTimer)
-                m_reconnectTimer->start(10000);
-        }
-    }
-}
-
-void IntegrationPluginUniPi::onModbusTCPStateChanged(QModbusDevice::State state)
-{
-    bool connected = (state == QModbusDevice::State::ConnectedState);
-
-    if (!connected) {
-        //try to reconnect in 10 seconds
-        if (m_reconnectTimer)
-            m_reconnectTimer->start(10000);
-    }
-    qCDebug(dcUniPi()) << "Connection status changed:" << connected;
-}
-
-void IntegrationPluginUniPi::onModbusRTUStateChanged(QModbusDevice::State state)
-{
-    bool connected = (state == QModbusDevice::State::ConnectedState);
-
-    if (!connected) {
-        //try to reconnect in 10 seconds
-        if (m_reconnectTimer)
-            m_reconnectTimer->start(10000);
-    }
-    qCDebug(dcUniPi()) << "Connection status changed:" << connected;
-}
-
 void IntegrationPluginUniPi::onUniPiDigitalInputStatusChanged(const QString &circuit, bool value)
 {
     qDebug(dcUniPi) << "Digital Input changed" << circuit << value;
     Q_FOREACH (Thing *thing, myThings().filterByThingClassId(digitalInputThingClassId)) {
         if (thing->paramValue(digitalInputThingCircuitParamTypeId).toString() == circuit) {
-
+            recordSnapshot(thing, value);
             thing->setStateValue(digitalInputInputStatusStateTypeId, value);
             return;
         }
@@ -965,6 +1355,7 @@ void IntegrationPluginUniPi::onUniPiDigitalOutputStatusChanged(const QString &ci
     qDebug(dcUniPi) << "Digital Output changed" << circuit << value;
     Q_FOREACH (Thing *thing, myThings().filterByThingClassId(digitalOutputThingClassId)) {
         if (thing->paramValue(digitalOutputThingCircuitParamTypeId).toString() == circuit) {
+            recordSnapshot(thing, value);
             thing->setStateValue(digitalOutputPowerStateTypeId, value);
             return;
         }
@@ -976,7 +1367,8 @@ void IntegrationPluginUniPi::onUniPiAnalogInputStatusChanged(const QString &circ
     qDebug(dcUniPi) << "Analog Input changed" << circuit << value;
     Q_FOREACH (Thing *thing, myThings().filterByThingClassId(analogInputThingClassId)) {
         if (thing->paramValue(analogInputThingCircuitParamTypeId).toString() == circuit) {
-            thing->setStateValue(analogInputInputValueStateTypeId, value);
+            recordSnapshot(thing, value);
+            publishAnalogInput(thing, value, QDateTime::currentMSecsSinceEpoch());
             return;
         }
     }
@@ -986,6 +1378,7 @@ void IntegrationPluginUniPi::onUniPiAnalogOutputStatusChanged(double value)
 {
     qDebug(dcUniPi) << "Analog output changed" << value;
     Q_FOREACH (Thing *thing, myThings().filterByThingClassId(analogOutputThingClassId)) {
+        recordSnapshot(thing, value);
         thing->setStateValue(analogOutputOutputValueStateTypeId, value);
         return;
     }
@@ -1000,10 +1393,11 @@ bool IntegrationPluginUniPi::neuronDeviceInit()
         m_modbusTCPMaster = new QModbusTcpClient(this);
         m_modbusTCPMaster->setConnectionParameter(QModbusDevice::NetworkPortParameter, port);
         m_modbusTCPMaster->setConnectionParameter(QModbusDevice::NetworkAddressParameter, ipAddress.toString());
+        // Timeout and retries are adapted to the measured response times by the Neurons,
+        // all of them talk to the same server and share one estimate
         m_modbusTCPMaster->setTimeout(1000);
-        m_modbusTCPMaster->setNumberOfRetries(3);
-
-        connect(m_modbusTCPMaster, &QModbusTcpClient::stateChanged, this, &IntegrationPluginUniPi::onModbusTCPStateChanged);
+        m_modbusTCPMaster->setNumberOfRetries(1);
+        m_modbusTCPRttEstimator = ModbusRttEstimator(1000, 50, 1000);
 
         if (!m_modbusTCPMaster->connectDevice()) {
             qCWarning(dcUniPi()) << "Connect failed:" << m_modbusTCPMaster->errorString();
@@ -1011,6 +1405,11 @@ bool IntegrationPluginUniPi::neuronDeviceInit()
             m_modbusTCPMaster = nullptr;
             return false;
         }
+        m_modbusTCPReconnector = new ModbusReconnector(m_modbusTCPMaster, "TCP", m_modbusTCPMaster);
+        m_modbusTCPTimeoutWheel = new ModbusTimeoutWheel(50, m_modbusTCPMaster);
+        m_modbusTCPTransactionWindow = new ModbusTransactionWindow(m_modbusTCPMaster);
+        m_modbusTCPTransactionWindow->setSize(configValue(uniPiPluginTransactionWindowParamTypeId).toInt());
+        connect(m_modbusTCPReconnector, &ModbusReconnector::retryChanged, this, &IntegrationPluginUniPi::updateReconnectStates);
     }
     return true;
 }
@@ -1032,10 +1431,7 @@ bool IntegrationPluginUniPi::neuronExtensionInterfaceInit()
         m_modbusRTUMaster->setConnectionParameter(QModbusDevice::SerialBaudRateParameter, baudrate);
         m_modbusRTUMaster->setConnectionParameter(QModbusDevice::SerialDataBitsParameter, 8);
         m_modbusRTUMaster->setConnectionParameter(QModbusDevice::SerialStopBitsParameter, 1);
-        //m_modbusRTUMaster->setTimeout(100);
-        //m_modbusRTUMaster->setNumberOfRetries(1);
-
-        connect(m_modbusRTUMaster, &QModbusRtuSerialMaster::stateChanged, this, &IntegrationPluginUniPi::onModbusRTUStateChanged);
+        // Timeout and retries are set per transaction by the addressed extension
 
         if (!m_modbusRTUMaster->connectDevice()) {
             qCWarning(dcUniPi()) << "Connect failed:" << m_modbusRTUMaster->errorString();
@@ -1043,6 +1439,13 @@ bool IntegrationPluginUniPi::neuronExtensionInterfaceInit()
             m_modbusRTUMaster = nullptr;
             return false;
         }
+        m_modbusRTUReconnector = new ModbusReconnector(m_modbusRTUMaster, "RTU", m_modbusRTUMaster);
+        connect(m_modbusRTUReconnector, &ModbusReconnector::retryChanged, this, &IntegrationPluginUniPi::updateReconnectStates);
+
+        m_neuronExtensionBus = new NeuronExtensionBus(m_modbusRTUMaster, this);
+        m_neuronExtensionBus->setInputPollingInterval(configValue(uniPiPluginRtuInputPollIntervalParamTypeId).toInt());
+        m_neuronExtensionBus->setOutputPollingInterval(configValue(uniPiPluginRtuOutputPollIntervalParamTypeId).toInt());
+        m_neuronExtensionBus->setCounterPollingInterval(configValue(uniPiPluginCounterPollIntervalParamTypeId).toInt());
     }
     return true;
 }
@@ -36,6 +36,9 @@
 #include "unipi.h"
 #include "neuron.h"
 #include "neuronextension.h"
+#include "neuronextensionbus.h"
+#include "modbusreconnector.h"
+#include "iosnapshot.h"
 
 #include <QTimer>
 #include <QtSerialBus>
@@ -52,6 +55,7 @@ class IntegrationPluginUniPi : public IntegrationPlugin
 public:
 
     explicit IntegrationPluginUniPi();
+    ~IntegrationPluginUniPi() override;
     void init() override;
 
     void discoverThings(ThingDiscoveryInfo *info) override;
@@ -61,19 +65,61 @@ public:
     void thingRemoved(Thing *thing) override;
 
 private:
+    struct AnalogInputFilter {
+        bool published = false;
+        qint64 lastPublished = 0;
+        bool pending = false;
+        double pendingValue = 0;
+    };
+
+    struct CounterSample {
+        bool valid = false;
+        quint32 count = 0;
+        qint64 timestamp = 0;
+    };
+
     UniPi *m_unipi = nullptr;
     QHash<ThingId, Neuron *> m_neurons;
     QHash<ThingId, NeuronExtension *> m_neuronExtensions;
+    QHash<Neuron *, ThingId> m_neuronThingIds;
+    QHash<NeuronExtension *, ThingId> m_neuronExtensionThingIds;
+    QHash<ThingId, QHash<QPair<int, QString>, Thing *> > m_circuitThings; // parent thing, circuit kind and name
     QModbusTcpClient *m_modbusTCPMaster = nullptr;
     QModbusRtuSerialMaster *m_modbusRTUMaster = nullptr;
+    NeuronExtensionBus *m_neuronExtensionBus = nullptr;
 
     QHash<Thing *, QTimer *> m_unlatchTimer;
-    QTimer *m_reconnectTimer = nullptr;
+    ModbusReconnector *m_modbusTCPReconnector = nullptr;
+    ModbusReconnector *m_modbusRTUReconnector = nullptr;
+    ModbusRttEstimator m_modbusTCPRttEstimator;
+    ModbusTimeoutWheel *m_modbusTCPTimeoutWheel = nullptr;
+    ModbusTransactionWindow *m_modbusTCPTransactionWindow = nullptr;
+    QTimer *m_analogPublishTimer = nullptr;
+    QTimer *m_snapshotTimer = nullptr;
+    IoSnapshot m_ioSnapshot;
+    QString m_ioSnapshotFileName;
+    QHash<ThingId, AnalogInputFilter> m_analogInputFilters;
+    QHash<ThingId, CounterSample> m_counterSamples;
+    QHash<ThingId, double> m_pwmOnDutyCycles;   // duty cycle restored when a PWM output is switched on
     QHash<QUuid, ThingActionInfo *> m_asyncActions;
     QHash<ThingClassId, StateTypeId> m_connectionStateTypeIds;
+    QHash<ThingClassId, ActionTypeId> m_setDigitalOutputsActionTypeIds;
+    QHash<ThingClassId, ParamTypeId> m_setDigitalOutputsParamTypeIds;
+    QHash<ThingClassId, EventTypeId> m_watchdogResetEventTypeIds;
+    QHash<ThingClassId, StateTypeId> m_liveStateTypeIds;
+    QHash<ThingClassId, StateTypeId> m_reconnectAttemptStateTypeIds;
+    QHash<ThingClassId, StateTypeId> m_nextReconnectStateTypeIds;
 
     bool neuronDeviceInit();
     bool neuronExtensionInterfaceInit();
+    void applyIoChanges(const ThingId &parentId, const IoChangeSet &changeSet);
+    QPair<int, QString> circuitKey(Thing *thing) const;
+    void indexCircuitThing(Thing *thing);
+    void restoreSnapshot(Thing *thing);
+    void recordSnapshot(Thing *thing, double value);
+    void configureDigitalInput(Thing *thing);
+    void publishAnalogInput(Thing *thing, double value, qint64 timestamp);
+    void updatePulseCounter(Thing *thing, quint32 count, qint64 timestamp);
 
 private slots:
     void onPluginConfigurationChanged(const ParamTypeId &paramTypeId, const QVariant &value);
@@ -82,23 +128,14 @@ private slots:
     void onRequestError(const QUuid &requestId, const QString &error);
 
     void onNeuronConnectionStateChanged(bool state);
-    void onNeuronDigitalInputStatusChanged(const QString &circuit, bool value);
-    void onNeuronDigitalOutputStatusChanged(const QString &circuit, bool value);
-    void onNeuronAnalogInputStatusChanged(const QString &circuit, double value);
-    void onNeuronAnalogOutputStatusChanged(const QString &circuit,double value);
-    void onNeuronUserLEDStatusChanged(const QString &circuit, bool value);
+    void onNeuronIoChanged(const IoChangeSet &changeSet);
 
     void onNeuronExtensionConnectionStateChanged(bool state);
-    void onNeuronExtensionDigitalInputStatusChanged(const QString &circuit, bool value);
-    void onNeuronExtensionDigitalOutputStatusChanged(const QString &circuit, bool value);
-    void onNeuronExtensionAnalogInputStatusChanged(const QString &circuit, double value);
-    void onNeuronExtensionAnalogOutputStatusChanged(const QString &circuit,double value);
-    void onNeuronExtensionUserLEDStatusChanged(const QString &circuit, bool value);
-
-    void onReconnectTimer();
+    void onNeuronExtensionIoChanged(const IoChangeSet &changeSet);
 
-    void onModbusTCPStateChanged(QModbusDevice::State state);
-    void onModbusRTUStateChanged(QModbusDevice::State state);
+    void onAnalogPublishTimer();
+    void updateReconnectStates();
+    void onSnapshotTimer();
 
     void onUniPiDigitalInputStatusChanged(const QString &circuit, bool value);
     void onUniPiDigitalOutputStatusChanged(const QString &circuit, bool value);
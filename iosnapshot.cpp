@@ -0,0 +1,146 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "iosnapshot.h"
+#include "extern-plugininfo.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+
+bool IoSnapshot::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (magic != Magic || version != Version) {
+        qCWarning(dcUniPi()) << "Ignoring I/O snapshot" << fileName << "of unknown format";
+        return false;
+    }
+
+    QHash<QUuid, QHash<QPair<int, QString>, Entry> > devices;
+    quint32 deviceCount;
+    stream >> deviceCount;
+    for (quint32 i = 0; i < deviceCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid deviceId;
+        quint32 entryCount;
+        stream >> deviceId >> entryCount;
+        QHash<QPair<int, QString>, Entry> &entries = devices[deviceId];
+        for (quint32 j = 0; j < entryCount && stream.status() == QDataStream::Ok; j++) {
+            qint32 type;
+            QString circuit;
+            Entry entry;
+            stream >> type >> circuit >> entry.value;
+            entry.stale = true;
+            entries.insert(qMakePair(static_cast<int>(type), circuit), entry);
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcUniPi()) << "Ignoring truncated I/O snapshot" << fileName;
+        return false;
+    }
+
+    m_devices = devices;
+    m_dirty = false;
+    return true;
+}
+
+bool IoSnapshot::save(const QString &fileName)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(dcUniPi()) << "Could not write I/O snapshot" << fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << Magic << Version << static_cast<quint32>(m_devices.count());
+    for (auto device = m_devices.constBegin(); device != m_devices.constEnd(); ++device) {
+        stream << device.key() << static_cast<quint32>(device.value().count());
+        for (auto entry = device.value().constBegin(); entry != device.value().constEnd(); ++entry) {
+            stream << static_cast<qint32>(entry.key().first) << entry.key().second << entry.value().value;
+        }
+    }
+
+    if (!file.commit()) {
+        qCWarning(dcUniPi()) << "Could not write I/O snapshot" << fileName << file.errorString();
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+
+void IoSnapshot::setValue(const QUuid &deviceId, int type, const QString &circuit, double value)
+{
+    QHash<QPair<int, QString>, Entry> &entries = m_devices[deviceId];
+    QPair<int, QString> key = qMakePair(type, circuit);
+    QHash<QPair<int, QString>, Entry>::const_iterator current = entries.constFind(key);
+    if (current != entries.constEnd() && current.value().value == value && !current.value().stale)
+        return;
+
+    Entry entry;
+    entry.value = value;
+    entries.insert(key, entry);
+    m_dirty = true;
+}
+
+bool IoSnapshot::value(const QUuid &deviceId, int type, const QString &circuit, double *value, bool *stale) const
+{
+    QHash<QUuid, QHash<QPair<int, QString>, Entry> >::const_iterator device = m_devices.constFind(deviceId);
+    if (device == m_devices.constEnd())
+        return false;
+
+    QHash<QPair<int, QString>, Entry>::const_iterator entry = device.value().constFind(qMakePair(type, circuit));
+    if (entry == device.value().constEnd())
+        return false;
+
+    *value = entry.value().value;
+    if (stale)
+        *stale = entry.value().stale;
+    return true;
+}
+
+void IoSnapshot::removeDevice(const QUuid &deviceId)
+{
+    if (m_devices.remove(deviceId))
+        m_dirty = true;
+}
+
+bool IoSnapshot::isDirty() const
+{
+    return m_dirty;
+}
@@ -0,0 +1,67 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef IOSNAPSHOT_H
+#define IOSNAPSHOT_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QUuid>
+
+// Last known circuit values per device, checkpointed to a binary file so the
+// things have plausible states right after a restart. Values loaded from the
+// file are stale until a live read confirms or replaces them.
+class IoSnapshot
+{
+public:
+    bool load(const QString &fileName);
+    bool save(const QString &fileName);
+
+    void setValue(const QUuid &deviceId, int type, const QString &circuit, double value);
+    bool value(const QUuid &deviceId, int type, const QString &circuit, double *value, bool *stale = nullptr) const;
+    void removeDevice(const QUuid &deviceId);
+
+    bool isDirty() const;
+
+private:
+    struct Entry {
+        double value = 0;
+        bool stale = false;
+    };
+
+    static const quint32 Magic = 0x5550494f;    // "UPIO"
+    static const quint16 Version = 1;
+
+    QHash<QUuid, QHash<QPair<int, QString>, Entry> > m_devices;
+    bool m_dirty = false;
+};
+
+#endif // IOSNAPSHOT_H
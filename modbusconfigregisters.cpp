@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusconfigregisters.h"
+#include "extern-plugininfo.h"
+
+void ModbusConfigRegisters::clear()
+{
+    m_registers.clear();
+}
+
+void ModbusConfigRegisters::set(int address, quint16 value, quint16 mask)
+{
+    Register &configRegister = m_registers[address];
+    configRegister.value = (configRegister.value & ~mask) | (value & mask);
+    configRegister.mask |= mask;
+}
+
+void ModbusConfigRegisters::unset(int address, quint16 mask)
+{
+    if (!m_registers.contains(address))
+        return;
+
+    Register &configRegister = m_registers[address];
+    configRegister.mask &= ~mask;
+    configRegister.value &= configRegister.mask;
+    if (!configRegister.mask)
+        m_registers.remove(address);
+}
+
+bool ModbusConfigRegisters::contains(int address) const
+{
+    return m_registers.contains(address);
+}
+
+QList<QModbusDataUnit> ModbusConfigRegisters::readRequests()
+{
+    QList<QModbusDataUnit> requests;
+    foreach (int address, m_registers.keys()) {
+        requests.append(readRequest(address));
+    }
+    return requests;
+}
+
+QModbusDataUnit ModbusConfigRegisters::readRequest(int address)
+{
+    if (m_registers.contains(address))
+        m_registers[address].state = Reading;
+
+    return QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, address, 1);
+}
+
+QList<QModbusDataUnit> ModbusConfigRegisters::handleRead(const QModbusDataUnit &unit)
+{
+    QList<QModbusDataUnit> writes;
+    if (unit.registerType() != QModbusDataUnit::RegisterType::HoldingRegisters)
+        return writes;
+
+    for (int i = 0; i < static_cast<int>(unit.valueCount()); i++) {
+        int address = unit.startAddress() + i;
+        if (!m_registers.contains(address))
+            continue;
+
+        Register &configRegister = m_registers[address];
+        quint16 current = unit.value(i);
+        if ((current & configRegister.mask) == configRegister.value) {
+            if (configRegister.state == Verifying)
+                qCDebug(dcUniPi()) << "Configuration register" << address << "set to" << current;
+            configRegister.state = Idle;
+        } else if (configRegister.state == Reading) {
+            QModbusDataUnit write(QModbusDataUnit::RegisterType::HoldingRegisters, address, 1);
+            write.setValue(0, (current & ~configRegister.mask) | configRegister.value);
+            writes.append(write);
+            configRegister.state = Writing;
+        } else if (configRegister.state == Verifying) {
+            qCWarning(dcUniPi()) << "Configuration register" << address << "reads back" << current << "instead of" << configRegister.value;
+            configRegister.state = Idle;
+        }
+    }
+    return writes;
+}
+
+QList<QModbusDataUnit> ModbusConfigRegisters::handleWrite(const QModbusDataUnit &unit, bool success)
+{
+    QList<QModbusDataUnit> reads;
+    if (unit.registerType() != QModbusDataUnit::RegisterType::HoldingRegisters)
+        return reads;
+
+    for (int i = 0; i < static_cast<int>(unit.valueCount()); i++) {
+        int address = unit.startAddress() + i;
+        if (!m_registers.contains(address) || m_registers.value(address).state != Writing)
+            continue;
+
+        if (success) {
+            m_registers[address].state = Verifying;
+            reads.append(QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, address, 1));
+        } else {
+            qCWarning(dcUniPi()) << "Could not write configuration register" << address;
+            m_registers[address].state = Idle;
+        }
+    }
+    return reads;
+}
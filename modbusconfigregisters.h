@@ -0,0 +1,75 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSCONFIGREGISTERS_H
+#define MODBUSCONFIGREGISTERS_H
+
+#include <QHash>
+#include <QList>
+#include <QModbusDataUnit>
+
+// Desired values of device configuration holding registers. Each register is
+// read, written only if it differs from the desired value and read back.
+class ModbusConfigRegisters
+{
+public:
+    void clear();
+
+    // Only the bits in mask are managed, several settings may share a register
+    void set(int address, quint16 value, quint16 mask = 0xffff);
+    void unset(int address, quint16 mask = 0xffff);
+    bool contains(int address) const;
+
+    // Read requests to check the registers against the device, all of them or a single one
+    QList<QModbusDataUnit> readRequests();
+    QModbusDataUnit readRequest(int address);
+
+    // Feed holding register responses, return the follow up requests
+    QList<QModbusDataUnit> handleRead(const QModbusDataUnit &unit);
+    QList<QModbusDataUnit> handleWrite(const QModbusDataUnit &unit, bool success);
+
+private:
+    enum State {
+        Idle,
+        Reading,
+        Writing,
+        Verifying
+    };
+
+    struct Register {
+        quint16 value = 0;
+        quint16 mask = 0;
+        State state = Idle;
+    };
+
+    QHash<int, Register> m_registers;
+};
+
+#endif // MODBUSCONFIGREGISTERS_H
@@ -0,0 +1,434 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusmap.h"
+#include "extern-plugininfo.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QtEndian>
+
+#include <algorithm>
+
+#ifdef MODBUS_MAP_TABLES
+#include "modbusmaptables.h"
+#endif
+
+// Cache layout, all little endian: a 24 byte header, fixed size entry records,
+// then the circuit names as one Latin-1 string table
+//
+// header:  magic u32, version u16, reserved u16, entry count u32,
+//          string table size u32, source stamp u64
+// entry:   address u16, type u8, bit i8, data type u8, circuit length u8,
+//          circuit offset u16, scale f64, offset f64
+static const int CacheHeaderSize = 24;
+static const int CacheEntrySize = 24;
+
+QHash<QString, QWeakPointer<const ModbusMapLayout> > ModbusMap::s_layouts;
+
+bool ModbusMap::load(const QString &name, const QStringList &coilFiles, const QStringList &registerFiles)
+{
+    if (loadCompiled(coilFiles + registerFiles))
+        return true;
+
+    QString cacheFile = cacheFileName(name);
+    quint64 stamp = sourceStamp(coilFiles + registerFiles);
+    if (readCache(cacheFile, stamp))
+        return true;
+
+    qCDebug(dcUniPi()) << "Compiling modbus map" << name;
+    if (!compile(coilFiles, registerFiles))
+        return false;
+
+    writeCache(cacheFile, stamp);
+    return true;
+}
+
+const QVector<ModbusMap::Entry> &ModbusMap::entries() const
+{
+    return m_entries;
+}
+
+QSharedPointer<const ModbusMapLayout> ModbusMap::layout(const QString &name, const QStringList &coilFiles, const QStringList &registerFiles)
+{
+    QSharedPointer<const ModbusMapLayout> layout = s_layouts.value(name).toStrongRef();
+    if (layout)
+        return layout;
+
+    ModbusMap map;
+    if (!map.load(name, coilFiles, registerFiles))
+        return QSharedPointer<const ModbusMapLayout>();
+
+    layout = QSharedPointer<const ModbusMapLayout>(map.buildLayout());
+    s_layouts.insert(name, layout);
+    return layout;
+}
+
+QSharedPointer<const ModbusMapLayout> ModbusMap::emptyLayout()
+{
+    static QSharedPointer<const ModbusMapLayout> empty(new ModbusMapLayout);
+    return empty;
+}
+
+ModbusMapLayout *ModbusMap::buildLayout() const
+{
+    ModbusMapLayout *layout = new ModbusMapLayout;
+    foreach (const Entry &entry, m_entries) {
+        switch (entry.type) {
+        case DigitalInput:
+            layout->digitalInputRegisters.insert(entry.circuit, entry.address);
+            break;
+        case DigitalOutput:
+            layout->digitalOutputRegisters.insert(entry.circuit, entry.address);
+            break;
+        case UserLED:
+            layout->userLEDRegisters.insert(entry.circuit, entry.address);
+            break;
+        case WatchdogResetCoil:
+            layout->watchdogResetCoils.append(entry.address);
+            break;
+        case PackedDigitalInput:
+            layout->packedDigitalInputBits[entry.address].insert(entry.bit, entry.circuit);
+            break;
+        case PackedDigitalOutput:
+            layout->packedDigitalOutputBits[entry.address].insert(entry.bit, entry.circuit);
+            break;
+        case DirectSwitchEnable:
+            layout->directSwitchEnableBits.insert(entry.circuit, qMakePair(entry.address, entry.bit));
+            break;
+        case DirectSwitchToggle:
+            layout->directSwitchToggleBits.insert(entry.circuit, qMakePair(entry.address, entry.bit));
+            break;
+        case DirectSwitchInvert:
+            layout->directSwitchInvertBits.insert(entry.circuit, qMakePair(entry.address, entry.bit));
+            break;
+        case AnalogInput:
+            layout->analogInputRegisters.insert(entry.circuit, entry.address);
+            layout->analogFormats.insert(entry.circuit, entry.format);
+            break;
+        case AnalogOutput:
+            layout->analogOutputRegisters.insert(entry.circuit, entry.address);
+            layout->analogFormats.insert(entry.circuit, entry.format);
+            break;
+        case DigitalInputCounter:
+            layout->digitalInputCounterRegisters.insert(entry.circuit, entry.address);
+            break;
+        case DebounceTime:
+            layout->digitalInputDebounceRegisters.insert(entry.circuit, entry.address);
+            break;
+        case WatchdogStatus:
+            layout->watchdogStatusRegisters.append(entry.address);
+            break;
+        case WatchdogTimeout:
+            layout->watchdogTimeoutRegisters.append(entry.address);
+            break;
+        case PwmDutyCycle:
+            layout->pwmDutyCycleRegisters.insert(entry.circuit, entry.address);
+            break;
+        case PwmPrescaler:
+            layout->pwmPrescalerRegister = entry.address;
+            break;
+        case PwmCycleLength:
+            layout->pwmCycleLengthRegister = entry.address;
+            break;
+        }
+    }
+    return layout;
+}
+
+QString ModbusMap::mapDirectory()
+{
+    return QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation).last() + "/nymea/modbus";
+}
+
+QString ModbusMap::cacheFileName(const QString &name)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/unipi-modbus-maps/" + name + ".map";
+}
+
+quint64 ModbusMap::sourceStamp(const QStringList &files)
+{
+    // Changed or reinstalled CSV files invalidate the cache
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(QByteArray::number(CacheVersion));
+    foreach (const QString &file, files) {
+        QFileInfo fileInfo(mapDirectory() + file);
+        hash.addData(file.toUtf8());
+        hash.addData(QByteArray::number(fileInfo.size()));
+        hash.addData(QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+    }
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(hash.result().constData()));
+}
+
+bool ModbusMap::loadCompiled(const QStringList &files)
+{
+#ifdef MODBUS_MAP_TABLES
+    QVector<Entry> entries;
+    const CompiledFile *begin = ModbusMapTables::files;
+    const CompiledFile *end = begin + sizeof(ModbusMapTables::files) / sizeof(CompiledFile);
+    foreach (const QString &fileName, files) {
+        QByteArray path = fileName.toLatin1();
+        const CompiledFile *file = std::lower_bound(begin, end, path, [] (const CompiledFile &file, const QByteArray &path) {
+            return qstrcmp(file.path, path.constData()) < 0;
+        });
+        if (file == end || qstrcmp(file->path, path.constData()) != 0)
+            return false;
+
+        for (int i = 0; i < file->count; i++) {
+            const CompiledEntry &compiled = file->entries[i];
+            Entry entry;
+            entry.type = compiled.type;
+            entry.address = compiled.address;
+            entry.bit = compiled.bit;
+            entry.circuit = QString::fromLatin1(compiled.circuit);
+            entry.format.dataType = compiled.dataType;
+            entry.format.scale = compiled.scale;
+            entry.format.offset = compiled.offset;
+            entries.append(entry);
+        }
+    }
+    m_entries = entries;
+    return true;
+#else
+    Q_UNUSED(files)
+    return false;
+#endif
+}
+
+QString ModbusMap::circuitName(const QString &content)
+{
+    // Rows like "Analog Output Value 1.1 (0..4000 ~ 0..10V)" document the
+    // range after the circuit, the name is the last token before it
+    QString name = content;
+    if (name.endsWith(")") && name.lastIndexOf(" (") > 0)
+        name.truncate(name.lastIndexOf(" ("));
+    return name.split(" ").last();
+}
+
+// Keep the classification in sync with modbusmapgenerator.py
+bool ModbusMap::classify(const QStringList &columns, bool coils, Entry &entry)
+{
+    if (columns.length() <= (coils ? 4 : 7))
+        return false;
+
+    entry.address = columns[0].toInt();
+    entry.bit = -1;
+    entry.format = ModbusValueCodec::Format();
+    QString category = columns.last();
+    QString content = coils ? columns[3] : columns[5];
+    entry.circuit = circuitName(content);
+
+    if (coils) {
+        if (category == "Basic" && content.contains("Digital Input", Qt::CaseInsensitive)) {
+            entry.type = DigitalInput;
+        } else if (category == "Basic" && (content.contains("Digital Output", Qt::CaseInsensitive) ||
+                                           content.contains("Relay Output", Qt::CaseInsensitive))) {
+            entry.type = DigitalOutput;
+        } else if (category == "Basic" && content.contains("User Programmable LED", Qt::CaseInsensitive)) {
+            entry.type = UserLED;
+        } else if (category == "Advanced" && content.startsWith("MWD reset indication", Qt::CaseInsensitive)) {
+            entry.type = WatchdogResetCoil;
+            entry.circuit = QString::number(entry.address);
+        } else {
+            return false;
+        }
+    } else if (category == "Basic" && columns[4] == "MixedBits" && !columns[6].isEmpty()) {
+        entry.bit = columns[6].toInt();
+        if (content.startsWith("Digital Input", Qt::CaseInsensitive)) {
+            entry.type = PackedDigitalInput;
+        } else if (content.startsWith("Digital Output", Qt::CaseInsensitive) ||
+                   content.startsWith("Relay Output", Qt::CaseInsensitive)) {
+            entry.type = PackedDigitalOutput;
+        } else if (content.startsWith("Enable DirectSwitch on DI", Qt::CaseInsensitive)) {
+            entry.type = DirectSwitchEnable;
+        } else if (content.startsWith("Enable DirectSwitch Toggle on DI", Qt::CaseInsensitive)) {
+            entry.type = DirectSwitchToggle;
+        } else if (content.startsWith("Invert DirectSwitch Polarity on DI", Qt::CaseInsensitive)) {
+            entry.type = DirectSwitchInvert;
+        } else {
+            return false;
+        }
+    } else if (category == "Basic") {
+        if (content.contains("Analog Input Value", Qt::CaseInsensitive)) {
+            entry.type = AnalogInput;
+            entry.format = ModbusValueCodec::format(columns[4], content);
+        } else if (content.contains("Analog Output Value", Qt::CaseInsensitive)) {
+            entry.type = AnalogOutput;
+            entry.format = ModbusValueCodec::format(columns[4], content);
+        } else if (content.startsWith("Counter of Digital Input", Qt::CaseInsensitive)) {
+            entry.type = DigitalInputCounter;
+        } else if (content.startsWith("PWM Duty Cycle of DO", Qt::CaseInsensitive)) {
+            entry.type = PwmDutyCycle;
+        } else if (content.startsWith("PWM Group prescaler", Qt::CaseInsensitive)) {
+            entry.type = PwmPrescaler;
+        } else if (content.startsWith("PWM Group cycle length", Qt::CaseInsensitive)) {
+            entry.type = PwmCycleLength;
+        } else {
+            return false;
+        }
+    } else if (category == "Advanced") {
+        if (content.startsWith("Debounce time", Qt::CaseInsensitive)) {
+            entry.type = DebounceTime;
+        } else if (content.startsWith("Group MasterWatchDog (MWD) Status", Qt::CaseInsensitive)) {
+            entry.type = WatchdogStatus;
+        } else if (content.startsWith("Group MasterWatchDog (MWD) Timeout", Qt::CaseInsensitive)) {
+            entry.type = WatchdogTimeout;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ModbusMap::compile(const QStringList &coilFiles, const QStringList &registerFiles)
+{
+    QVector<Entry> entries;
+    QStringList files = coilFiles + registerFiles;
+    for (int i = 0; i < files.count(); i++) {
+        bool coils = i < coilFiles.count();
+        QFile csvFile(mapDirectory() + files.at(i));
+        if (!csvFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qCWarning(dcUniPi()) << csvFile.errorString() << "Path:" << csvFile.fileName();
+            return false;
+        }
+        QTextStream textStream(&csvFile);
+        while (!textStream.atEnd()) {
+            QStringList list = textStream.readLine().split(',');
+            if (list.length() <= (coils ? 4 : 7)) {
+                qCWarning(dcUniPi()) << "currupted CSV file:" << csvFile.fileName();
+                return false;
+            }
+
+            Entry entry;
+            if (classify(list, coils, entry))
+                entries.append(entry);
+        }
+    }
+    m_entries = entries;
+    return true;
+}
+
+bool ModbusMap::readCache(const QString &fileName, quint64 stamp)
+{
+    // The records are copied into the entries right away, a plain read of the
+    // few kilobytes is all it takes
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < CacheHeaderSize)
+        return false;
+
+    const QByteArray content = file.readAll();
+    const uchar *data = reinterpret_cast<const uchar *>(content.constData());
+
+    quint32 entryCount = qFromLittleEndian<quint32>(data + 8);
+    quint32 stringTableSize = qFromLittleEndian<quint32>(data + 12);
+    if (qFromLittleEndian<quint32>(data) != CacheMagic || qFromLittleEndian<quint16>(data + 4) != CacheVersion ||
+            qFromLittleEndian<quint64>(data + 16) != stamp ||
+            content.size() != CacheHeaderSize + static_cast<qint64>(entryCount) * CacheEntrySize + stringTableSize) {
+        return false;
+    }
+
+    const uchar *strings = data + CacheHeaderSize + entryCount * CacheEntrySize;
+    QVector<Entry> entries;
+    entries.reserve(static_cast<int>(entryCount));
+    for (quint32 i = 0; i < entryCount; i++) {
+        const uchar *record = data + CacheHeaderSize + i * CacheEntrySize;
+        quint16 circuitOffset = qFromLittleEndian<quint16>(record + 6);
+        quint8 circuitLength = record[5];
+        if (record[2] > PwmCycleLength || record[4] > ModbusValueCodec::MixedBits || circuitOffset + circuitLength > stringTableSize)
+            return false;
+
+        Entry entry;
+        entry.address = qFromLittleEndian<quint16>(record);
+        entry.type = static_cast<EntryType>(record[2]);
+        entry.bit = static_cast<qint8>(record[3]);
+        entry.format.dataType = static_cast<ModbusValueCodec::DataType>(record[4]);
+        entry.circuit = QString::fromLatin1(reinterpret_cast<const char *>(strings + circuitOffset), circuitLength);
+        quint64 scale = qFromLittleEndian<quint64>(record + 8);
+        quint64 offset = qFromLittleEndian<quint64>(record + 16);
+        memcpy(&entry.format.scale, &scale, sizeof(double));
+        memcpy(&entry.format.offset, &offset, sizeof(double));
+        entries.append(entry);
+    }
+
+    m_entries = entries;
+    return true;
+}
+
+bool ModbusMap::writeCache(const QString &fileName, quint64 stamp) const
+{
+    QByteArray strings;
+    QByteArray records(m_entries.count() * CacheEntrySize, 0);
+    for (int i = 0; i < m_entries.count(); i++) {
+        const Entry &entry = m_entries.at(i);
+        QByteArray circuit = entry.circuit.toLatin1().left(255);
+        uchar *record = reinterpret_cast<uchar *>(records.data()) + i * CacheEntrySize;
+        qToLittleEndian<quint16>(static_cast<quint16>(entry.address), record);
+        record[2] = static_cast<uchar>(entry.type);
+        record[3] = static_cast<uchar>(static_cast<qint8>(entry.bit));
+        record[4] = static_cast<uchar>(entry.format.dataType);
+        record[5] = static_cast<uchar>(circuit.length());
+        qToLittleEndian<quint16>(static_cast<quint16>(strings.length()), record + 6);
+        quint64 scale;
+        quint64 offset;
+        memcpy(&scale, &entry.format.scale, sizeof(double));
+        memcpy(&offset, &entry.format.offset, sizeof(double));
+        qToLittleEndian<quint64>(scale, record + 8);
+        qToLittleEndian<quint64>(offset, record + 16);
+        strings.append(circuit);
+    }
+    if (strings.length() > 0xffff)
+        return false;
+
+    QByteArray header(CacheHeaderSize, 0);
+    uchar *headerData = reinterpret_cast<uchar *>(header.data());
+    qToLittleEndian<quint32>(CacheMagic, headerData);
+    qToLittleEndian<quint16>(CacheVersion, headerData + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(m_entries.count()), headerData + 8);
+    qToLittleEndian<quint32>(static_cast<quint32>(strings.length()), headerData + 12);
+    qToLittleEndian<quint64>(stamp, headerData + 16);
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(dcUniPi()) << "Could not write modbus map cache" << fileName << file.errorString();
+        return false;
+    }
+    file.write(header);
+    file.write(records);
+    file.write(strings);
+    return file.commit();
+}
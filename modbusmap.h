@@ -0,0 +1,156 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSMAP_H
+#define MODBUSMAP_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "modbusvaluecodec.h"
+
+// Lookup tables of one device model. Built once per model and shared
+// read-only by all devices of that model.
+struct ModbusMapLayout
+{
+    QHash<QString, int> digitalOutputRegisters;
+    QHash<QString, int> digitalInputRegisters;
+    QHash<QString, int> analogInputRegisters;
+    QHash<QString, int> analogOutputRegisters;
+    QHash<QString, int> userLEDRegisters;
+    QHash<QString, int> digitalInputCounterRegisters;
+    QHash<QString, int> digitalInputDebounceRegisters;
+    QHash<QString, QPair<int, int> > directSwitchEnableBits; // circuit, register address and bit number
+    QHash<QString, QPair<int, int> > directSwitchToggleBits;
+    QHash<QString, QPair<int, int> > directSwitchInvertBits;
+    QList<int> watchdogStatusRegisters;  // one MasterWatchDog per group
+    QList<int> watchdogTimeoutRegisters;
+    QList<int> watchdogResetCoils;
+    QHash<QString, int> pwmDutyCycleRegisters;
+    int pwmPrescalerRegister = -1;
+    int pwmCycleLengthRegister = -1;
+    QHash<QString, ModbusValueCodec::Format> analogFormats;
+    QHash<int, QHash<int, QString> > packedDigitalInputBits;  // register address, bit number, circuit
+    QHash<int, QHash<int, QString> > packedDigitalOutputBits; // register address, bit number, circuit
+};
+
+// The rows of a device's Modbus map that the plugin uses, classified once.
+// The CSV files are compiled into a versioned binary cache on first use,
+// later loads read the cache file instead of parsing the CSV files again.
+class ModbusMap
+{
+public:
+    enum EntryType {
+        DigitalInput,
+        DigitalOutput,
+        UserLED,
+        WatchdogResetCoil,
+        PackedDigitalInput,
+        PackedDigitalOutput,
+        DirectSwitchEnable,
+        DirectSwitchToggle,
+        DirectSwitchInvert,
+        AnalogInput,
+        AnalogOutput,
+        DigitalInputCounter,
+        DebounceTime,
+        WatchdogStatus,
+        WatchdogTimeout,
+        PwmDutyCycle,
+        PwmPrescaler,
+        PwmCycleLength
+    };
+
+    struct Entry {
+        EntryType type;
+        int address;
+        int bit;        // bit number of packed registers, -1 otherwise
+        QString circuit;
+        ModbusValueCodec::Format format;
+    };
+
+    // Rows of the tables generated from the map files at build time
+    struct CompiledEntry {
+        EntryType type;
+        int address;
+        int bit;
+        const char *circuit;
+        ModbusValueCodec::DataType dataType;
+        double scale;
+        double offset;
+    };
+
+    struct CompiledFile {
+        const char *path;
+        const CompiledEntry *entries;
+        int count;
+    };
+
+    // Paths are relative to the modbus map directory. Maps compiled into the
+    // plugin are used directly, the installed CSV files are the fallback.
+    bool load(const QString &name, const QStringList &coilFiles, const QStringList &registerFiles);
+
+    const QVector<Entry> &entries() const;
+
+    // Returns the shared layout of a model, loading the map only if no device
+    // of that model holds it yet. Returns a null pointer if the map can't be loaded.
+    static QSharedPointer<const ModbusMapLayout> layout(const QString &name, const QStringList &coilFiles, const QStringList &registerFiles);
+    static QSharedPointer<const ModbusMapLayout> emptyLayout();
+
+    static QString circuitName(const QString &content);
+
+    // Classifies one CSV row split into its columns. Returns false for rows
+    // the plugin doesn't use.
+    static bool classify(const QStringList &columns, bool coils, Entry &entry);
+
+private:
+    QVector<Entry> m_entries;
+
+    static QHash<QString, QWeakPointer<const ModbusMapLayout> > s_layouts;
+
+    static const quint32 CacheMagic = 0x55504d4d;  // "UPMM"
+    static const quint16 CacheVersion = 2;
+
+    static QString mapDirectory();
+    static QString cacheFileName(const QString &name);
+    static quint64 sourceStamp(const QStringList &files);
+
+    ModbusMapLayout *buildLayout() const;
+    bool loadCompiled(const QStringList &files);
+    bool compile(const QStringList &coilFiles, const QStringList &registerFiles);
+    bool readCache(const QString &fileName, quint64 stamp);
+    bool writeCache(const QString &fileName, quint64 stamp) const;
+};
+
+#endif // MODBUSMAP_H
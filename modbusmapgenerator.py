@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+
+# Copyright 2013 - 2020, nymea GmbH
+# Contact: contact@nymea.io
+#
+# This file is part of nymea.
+#
+# GNU Lesser General Public License Usage
+# This project may be redistributed and/or modified under the terms of the GNU
+# Lesser General Public License as published by the Free Software Foundation;
+# version 3. This project is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser
+# General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this project. If not, see <https://www.gnu.org/licenses/>.
+
+# Compiles the CSV files in modbus_maps into constexpr tables, one per file.
+# The rows are classified with the same rules as ModbusMap::classify(), keep
+# both in sync, tests/modbusmaptables compares the two.
+#
+# Usage: modbusmapgenerator.py <modbus_maps directory> <output header>
+
+import os
+import re
+import sys
+
+RANGE = re.compile(r'\((-?[\d.]+)\.\.(-?[\d.]+)\s*~\s*(-?[\d.]+)\.\.(-?[\d.]+)')
+
+
+def to_int(text):
+    try:
+        return int(text)
+    except ValueError:
+        return 0
+
+
+def to_double(text):
+    try:
+        return float(text)
+    except ValueError:
+        return 0.0
+
+
+def value_format(data_type, description):
+    data_type = data_type.lower()
+    if data_type == 'dword':
+        result = 'ModbusValueCodec::DWord'
+    elif data_type in ('real', 'float'):
+        result = 'ModbusValueCodec::Real'
+    elif data_type == 'mixedbits':
+        result = 'ModbusValueCodec::MixedBits'
+    else:
+        result = 'ModbusValueCodec::Word'
+
+    scale = 1.0
+    offset = 0.0
+    match = RANGE.search(description)
+    if match:
+        raw_min, raw_max, minimum, maximum = [to_double(group) for group in match.groups()]
+        if raw_max != raw_min:
+            scale = (maximum - minimum) / (raw_max - raw_min)
+            offset = minimum - raw_min * scale
+    return result, scale, offset
+
+
+def starts_with(text, prefix):
+    return text.lower().startswith(prefix.lower())
+
+
+def contains(text, part):
+    return part.lower() in text.lower()
+
+
+def circuit_name(content):
+    # Rows like "Analog Output Value 1.1 (0..4000 ~ 0..10V)" document the
+    # range after the circuit, the name is the last token before it
+    if content.endswith(')') and content.rfind(' (') > 0:
+        content = content[:content.rfind(' (')]
+    return content.split(' ')[-1]
+
+
+def classify(columns, coils):
+    category = columns[-1]
+    content = columns[3] if coils else columns[5]
+    entry = {
+        'address': to_int(columns[0]),
+        'bit': -1,
+        'circuit': circuit_name(content),
+        'format': ('ModbusValueCodec::Word', 1.0, 0.0),
+    }
+
+    if coils:
+        if category == 'Basic' and contains(content, 'Digital Input'):
+            entry['type'] = 'DigitalInput'
+        elif category == 'Basic' and (contains(content, 'Digital Output') or contains(content, 'Relay Output')):
+            entry['type'] = 'DigitalOutput'
+        elif category == 'Basic' and contains(content, 'User Programmable LED'):
+            entry['type'] = 'UserLED'
+        elif category == 'Advanced' and starts_with(content, 'MWD reset indication'):
+            entry['type'] = 'WatchdogResetCoil'
+            entry['circuit'] = str(entry['address'])
+        else:
+            return None
+    elif category == 'Basic' and columns[4] == 'MixedBits' and columns[6]:
+        entry['bit'] = to_int(columns[6])
+        if starts_with(content, 'Digital Input'):
+            entry['type'] = 'PackedDigitalInput'
+        elif starts_with(content, 'Digital Output') or starts_with(content, 'Relay Output'):
+            entry['type'] = 'PackedDigitalOutput'
+        elif starts_with(content, 'Enable DirectSwitch on DI'):
+            entry['type'] = 'DirectSwitchEnable'
+        elif starts_with(content, 'Enable DirectSwitch Toggle on DI'):
+            entry['type'] = 'DirectSwitchToggle'
+        elif starts_with(content, 'Invert DirectSwitch Polarity on DI'):
+            entry['type'] = 'DirectSwitchInvert'
+        else:
+            return None
+    elif category == 'Basic':
+        if contains(content, 'Analog Input Value'):
+            entry['type'] = 'AnalogInput'
+            entry['format'] = value_format(columns[4], content)
+        elif contains(content, 'Analog Output Value'):
+            entry['type'] = 'AnalogOutput'
+            entry['format'] = value_format(columns[4], content)
+        elif starts_with(content, 'Counter of Digital Input'):
+            entry['type'] = 'DigitalInputCounter'
+        elif starts_with(content, 'PWM Duty Cycle of DO'):
+            entry['type'] = 'PwmDutyCycle'
+        elif starts_with(content, 'PWM Group prescaler'):
+            entry['type'] = 'PwmPrescaler'
+        elif starts_with(content, 'PWM Group cycle length'):
+            entry['type'] = 'PwmCycleLength'
+        else:
+            return None
+    elif category == 'Advanced':
+        if starts_with(content, 'Debounce time'):
+            entry['type'] = 'DebounceTime'
+        elif starts_with(content, 'Group MasterWatchDog (MWD) Status'):
+            entry['type'] = 'WatchdogStatus'
+        elif starts_with(content, 'Group MasterWatchDog (MWD) Timeout'):
+            entry['type'] = 'WatchdogTimeout'
+        else:
+            return None
+    else:
+        return None
+    return entry
+
+
+def read_map(path, coils):
+    entries = []
+    with open(path, encoding='latin-1') as csv_file:
+        for line in csv_file:
+            columns = line.rstrip('\r\n').split(',')
+            if len(columns) <= (4 if coils else 7):
+                sys.exit('corrupted CSV file: %s' % path)
+            entry = classify(columns, coils)
+            if entry:
+                entries.append(entry)
+    return entries
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('Usage: %s <modbus_maps directory> <output header>' % sys.argv[0])
+    map_directory, output = sys.argv[1], sys.argv[2]
+
+    files = []
+    for directory, _, names in os.walk(map_directory):
+        for name in names:
+            if name.endswith('.csv'):
+                files.append('/' + os.path.relpath(os.path.join(directory, name), map_directory).replace(os.sep, '/'))
+    files.sort()
+
+    lines = [
+        '// Generated by modbusmapgenerator.py from the modbus_maps directory, do not edit.',
+        '',
+        '#ifndef MODBUSMAPTABLES_H',
+        '#define MODBUSMAPTABLES_H',
+        '',
+        '#include "modbusmap.h"',
+        '',
+        'namespace ModbusMapTables {',
+        '',
+    ]
+    tables = []
+    for index, relative_path in enumerate(files):
+        coils = '-Coils-' in relative_path
+        entries = read_map(map_directory + relative_path, coils)
+        table = 'table%d' % index
+        tables.append((relative_path, table, len(entries)))
+        lines.append('// %s' % relative_path)
+        lines.append('static constexpr ModbusMap::CompiledEntry %s[] = {' % table)
+        for entry in entries:
+            data_type, scale, offset = entry['format']
+            lines.append('    { ModbusMap::%s, %d, %d, "%s", %s, %r, %r },' % (entry['type'], entry['address'], entry['bit'],
+                                                                        entry['circuit'].replace('\\', '\\\\').replace('"', '\\"'), data_type, scale, offset))
+        if not entries:
+            lines.append('    { ModbusMap::DigitalInput, 0, -1, "", ModbusValueCodec::Word, 1.0, 0.0 }')
+        lines.append('};')
+        lines.append('')
+
+    lines.append('// Sorted by path')
+    lines.append('static constexpr ModbusMap::CompiledFile files[] = {')
+    for relative_path, table, count in tables:
+        lines.append('    { "%s", %s, %d },' % (relative_path, table, count))
+    lines.append('};')
+    lines.append('')
+    lines.append('}')
+    lines.append('')
+    lines.append('#endif // MODBUSMAPTABLES_H')
+
+    with open(output, 'w') as header:
+        header.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()
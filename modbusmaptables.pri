@@ -0,0 +1,11 @@
+# Compiles the modbus maps into constexpr tables in modbusmaptables.h
+MODBUS_MAPS = $$files($$PWD/modbus_maps/*.csv, true)
+modbusmaptables.name = Generate modbus map tables
+modbusmaptables.input = MODBUS_MAPS
+modbusmaptables.output = modbusmaptables.h
+modbusmaptables.commands = python3 $$PWD/modbusmapgenerator.py $$PWD/modbus_maps ${QMAKE_FILE_OUT}
+modbusmaptables.depends = $$PWD/modbusmapgenerator.py
+modbusmaptables.CONFIG += combine no_link target_predeps
+QMAKE_EXTRA_COMPILERS += modbusmaptables
+INCLUDEPATH += $$OUT_PWD
+DEFINES += MODBUS_MAP_TABLES
@@ -0,0 +1,90 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusreadplan.h"
+
+#include <algorithm>
+
+ModbusReadPlan::ModbusReadPlan(QModbusDataUnit::RegisterType registerType, int gapTolerance) :
+    m_registerType(registerType),
+    m_gapTolerance(qMax(0, gapTolerance))
+{
+
+}
+
+void ModbusReadPlan::addSpan(int address, int count)
+{
+    if (address < 0 || count <= 0)
+        return;
+
+    Span span;
+    span.address = address;
+    span.count = count;
+    m_spans.append(span);
+}
+
+void ModbusReadPlan::addAddresses(const QList<int> &addresses, int count)
+{
+    foreach (int address, addresses) {
+        addSpan(address, count);
+    }
+}
+
+QList<QModbusDataUnit> ModbusReadPlan::requests() const
+{
+    QList<QModbusDataUnit> requests;
+    if (m_spans.isEmpty())
+        return requests;
+
+    int maxCount = (m_registerType == QModbusDataUnit::Coils || m_registerType == QModbusDataUnit::DiscreteInputs) ? maxCoilCount : maxRegisterCount;
+
+    QList<Span> spans = m_spans;
+    std::sort(spans.begin(), spans.end(), [] (const Span &a, const Span &b) {
+        return a.address < b.address;
+    });
+
+    // Merge the sorted spans into blocks, reading over holes of up to m_gapTolerance
+    // addresses as long as the resulting block still fits into one PDU.
+    int startAddress = spans.first().address;
+    int endAddress = startAddress + spans.first().count; // exclusive
+    for (int i = 1; i < spans.count(); i++) {
+        const Span &span = spans.at(i);
+        int spanEnd = span.address + span.count;
+        if ((span.address - endAddress) <= m_gapTolerance && (qMax(endAddress, spanEnd) - startAddress) <= maxCount) {
+            endAddress = qMax(endAddress, spanEnd);
+        } else {
+            requests.append(QModbusDataUnit(m_registerType, startAddress, static_cast<quint16>(endAddress - startAddress)));
+            startAddress = span.address;
+            endAddress = spanEnd;
+        }
+    }
+    requests.append(QModbusDataUnit(m_registerType, startAddress, static_cast<quint16>(endAddress - startAddress)));
+    return requests;
+}
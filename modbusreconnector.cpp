@@ -0,0 +1,131 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusreconnector.h"
+#include "extern-plugininfo.h"
+
+#include <QtGlobal>
+
+ModbusReconnector::ModbusReconnector(QModbusDevice *device, const QString &name, QObject *parent) :
+    QObject(parent),
+    m_device(device),
+    m_name(name)
+{
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &ModbusReconnector::onRetryTimer);
+    connect(m_device, &QModbusDevice::stateChanged, this, &ModbusReconnector::onStateChanged);
+
+    if (m_device->state() == QModbusDevice::ConnectedState)
+        m_connectedClock.start();
+}
+
+void ModbusReconnector::setBackoff(int initialDelay, int maximumDelay)
+{
+    m_initialDelay = qMax(1, initialDelay);
+    m_maximumDelay = qMax(m_initialDelay, maximumDelay);
+}
+
+void ModbusReconnector::stop()
+{
+    m_enabled = false;
+    m_retryTimer->stop();
+    m_nextRetry = QDateTime();
+    emit retryChanged();
+}
+
+int ModbusReconnector::attempt() const
+{
+    return m_attempt;
+}
+
+QDateTime ModbusReconnector::nextRetry() const
+{
+    return m_nextRetry;
+}
+
+int ModbusReconnector::retryDelay() const
+{
+    if (m_attempt <= 1)
+        return 0;
+
+    // Doubles from the initial delay, a random half of it is dropped so several
+    // masters failing together don't retry in lockstep
+    qint64 delay = m_initialDelay;
+    for (int i = 2; i < m_attempt && delay < m_maximumDelay; i++) {
+        delay *= 2;
+    }
+    delay = qMin(delay, static_cast<qint64>(m_maximumDelay));
+    return static_cast<int>(delay / 2 + qrand() % (delay / 2 + 1));
+}
+
+void ModbusReconnector::scheduleRetry()
+{
+    if (!m_enabled || m_retryTimer->isActive())
+        return;
+
+    m_attempt++;
+    int delay = retryDelay();
+    m_nextRetry = QDateTime::currentDateTime().addMSecs(delay);
+    qCDebug(dcUniPi()) << "Modbus" << m_name << "reconnect attempt" << m_attempt << "in" << delay << "ms";
+    m_retryTimer->start(delay);
+    emit retryChanged();
+}
+
+void ModbusReconnector::onStateChanged(QModbusDevice::State state)
+{
+    qCDebug(dcUniPi()) << "Modbus" << m_name << "connection state changed:" << state;
+    if (state == QModbusDevice::ConnectedState) {
+        if (m_attempt > 0)
+            qCDebug(dcUniPi()) << "Modbus" << m_name << "reconnected after" << m_attempt << "attempts";
+        m_attempt = 0;
+        m_nextRetry = QDateTime();
+        m_connectedClock.start();
+        emit retryChanged();
+    } else if (state == QModbusDevice::UnconnectedState) {
+        // A transient drop is retried right away, a flapping connection keeps backing off
+        if (m_connectedClock.isValid() && m_connectedClock.elapsed() < StableConnectionTime && m_attempt == 0)
+            m_attempt = 1;
+        m_connectedClock.invalidate();
+        scheduleRetry();
+    }
+}
+
+void ModbusReconnector::onRetryTimer()
+{
+    m_nextRetry = QDateTime();
+    if (!m_enabled || m_device->state() != QModbusDevice::UnconnectedState)
+        return;
+
+    if (!m_device->connectDevice()) {
+        qCWarning(dcUniPi()) << "Reconnecting to modbus" << m_name << "failed:" << m_device->errorString();
+        scheduleRetry();
+    }
+}
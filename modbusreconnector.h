@@ -0,0 +1,81 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSRECONNECTOR_H
+#define MODBUSRECONNECTOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QModbusDevice>
+
+// Reconnects a modbus master after the connection dropped. The first attempt
+// is made right away, the following ones back off exponentially with jitter
+// up to a maximum delay.
+class ModbusReconnector : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ModbusReconnector(QModbusDevice *device, const QString &name, QObject *parent = nullptr);
+
+    void setBackoff(int initialDelay, int maximumDelay);
+    void stop();
+
+    // Diagnostics, attempt is 0 while connected
+    int attempt() const;
+    QDateTime nextRetry() const;
+
+signals:
+    void retryChanged();
+
+private:
+    QModbusDevice *m_device = nullptr;
+    QString m_name;
+    QTimer *m_retryTimer = nullptr;
+    QElapsedTimer m_connectedClock;
+    QDateTime m_nextRetry;
+    int m_initialDelay = 500;
+    int m_maximumDelay = 60000;
+    int m_attempt = 0;
+    bool m_enabled = true;
+
+    // A connection has to stay up that long to start over with an immediate retry
+    static const int StableConnectionTime = 10000;
+
+    int retryDelay() const;
+    void scheduleRetry();
+
+private slots:
+    void onStateChanged(QModbusDevice::State state);
+    void onRetryTimer();
+};
+
+#endif // MODBUSRECONNECTOR_H
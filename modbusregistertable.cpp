@@ -0,0 +1,76 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusregistertable.h"
+
+static const ModbusRegisterTable::Circuit noCircuit = ModbusRegisterTable::Circuit();
+
+void ModbusRegisterTable::clear()
+{
+    for (int i = 0; i <= QModbusDataUnit::HoldingRegisters; i++) {
+        m_tables[i].baseAddress = 0;
+        m_tables[i].circuits.clear();
+    }
+}
+
+void ModbusRegisterTable::insert(QModbusDataUnit::RegisterType registerType, int address, CircuitType type, const QString &circuit, const ModbusValueCodec &codec)
+{
+    if (registerType <= QModbusDataUnit::Invalid || registerType > QModbusDataUnit::HoldingRegisters || address < 0)
+        return;
+
+    Table &table = m_tables[registerType];
+    if (table.circuits.isEmpty()) {
+        table.baseAddress = address;
+    } else if (address < table.baseAddress) {
+        table.circuits.insert(0, table.baseAddress - address, Circuit());
+        table.baseAddress = address;
+    }
+
+    int index = address - table.baseAddress;
+    if (index >= table.circuits.size())
+        table.circuits.resize(index + 1);
+
+    table.circuits[index].type = type;
+    table.circuits[index].name = circuit;
+    table.circuits[index].codec = codec;
+}
+
+const ModbusRegisterTable::Circuit &ModbusRegisterTable::circuit(QModbusDataUnit::RegisterType registerType, int address) const
+{
+    if (registerType <= QModbusDataUnit::Invalid || registerType > QModbusDataUnit::HoldingRegisters)
+        return noCircuit;
+
+    const Table &table = m_tables[registerType];
+    int index = address - table.baseAddress;
+    if (index < 0 || index >= table.circuits.size())
+        return noCircuit;
+
+    return table.circuits.at(index);
+}
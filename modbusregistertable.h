@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSREGISTERTABLE_H
+#define MODBUSREGISTERTABLE_H
+
+#include <QString>
+#include <QVector>
+#include <QModbusDataUnit>
+
+#include "modbusvaluecodec.h"
+
+class ModbusRegisterTable
+{
+public:
+    enum CircuitType {
+        NoCircuit,
+        DigitalInput,
+        DigitalOutput,
+        AnalogInput,
+        AnalogOutput,
+        UserLED,
+        DigitalInputCounter,
+        WatchdogReset,
+        PwmOutput
+    };
+
+    struct Circuit {
+        CircuitType type = NoCircuit;
+        QString name;
+        ModbusValueCodec codec;
+    };
+
+    void clear();
+    void insert(QModbusDataUnit::RegisterType registerType, int address, CircuitType type, const QString &circuit, const ModbusValueCodec &codec = ModbusValueCodec());
+
+    // Flat, allocation free lookup for the response decoders
+    const Circuit &circuit(QModbusDataUnit::RegisterType registerType, int address) const;
+
+private:
+    struct Table {
+        int baseAddress = 0;
+        QVector<Circuit> circuits;
+    };
+
+    // Indexed by QModbusDataUnit::RegisterType, Invalid to HoldingRegisters
+    Table m_tables[QModbusDataUnit::HoldingRegisters + 1];
+};
+
+#endif // MODBUSREGISTERTABLE_H
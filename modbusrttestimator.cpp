@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusrttestimator.h"
+
+#include <QtGlobal>
+#include <QtMath>
+
+ModbusRttEstimator::ModbusRttEstimator(int initialTimeout, int minimumTimeout, int maximumTimeout) :
+    m_initialTimeout(initialTimeout),
+    m_minimumTimeout(minimumTimeout),
+    m_maximumTimeout(qMax(minimumTimeout, maximumTimeout))
+{
+
+}
+
+void ModbusRttEstimator::addSample(double milliseconds)
+{
+    milliseconds = qMax(0.0, milliseconds);
+    if (!m_hasSamples) {
+        m_srtt = milliseconds;
+        m_rttvar = milliseconds / 2;
+        m_hasSamples = true;
+    } else {
+        m_rttvar = 0.75 * m_rttvar + 0.25 * qAbs(m_srtt - milliseconds);
+        m_srtt = 0.875 * m_srtt + 0.125 * milliseconds;
+    }
+    m_consecutiveTimeouts = 0;
+}
+
+void ModbusRttEstimator::addTimeout()
+{
+    m_consecutiveTimeouts++;
+}
+
+int ModbusRttEstimator::timeout() const
+{
+    if (!m_hasSamples)
+        return qBound(m_minimumTimeout, m_initialTimeout, m_maximumTimeout);
+
+    // One millisecond clock granularity
+    int timeout = qCeil(m_srtt + qMax(1.0, 4 * m_rttvar));
+    return qBound(m_minimumTimeout, timeout, m_maximumTimeout);
+}
+
+int ModbusRttEstimator::retries() const
+{
+    // A single retry covers a corrupted frame, after two timeouts in a row
+    // the slave is considered gone until it answers again
+    return (m_consecutiveTimeouts >= 2) ? 0 : 1;
+}
+
+bool ModbusRttEstimator::hasSamples() const
+{
+    return m_hasSamples;
+}
+
+double ModbusRttEstimator::smoothedRtt() const
+{
+    return m_srtt;
+}
@@ -0,0 +1,63 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSRTTESTIMATOR_H
+#define MODBUSRTTESTIMATOR_H
+
+// Response time estimate of one slave, smoothed round trip time and its
+// variance as used for the TCP retransmission timeout (RFC 6298).
+class ModbusRttEstimator
+{
+public:
+    explicit ModbusRttEstimator(int initialTimeout = 1000, int minimumTimeout = 10, int maximumTimeout = 1000);
+
+    void addSample(double milliseconds);
+    void addTimeout();
+
+    // Unlike TCP the timeout is not backed off, a slave that stopped answering
+    // would hold a shared bus even longer. It loses its retries instead.
+    int timeout() const;
+    int retries() const;
+
+    bool hasSamples() const;
+    double smoothedRtt() const;
+
+private:
+    int m_initialTimeout = 1000;
+    int m_minimumTimeout = 10;
+    int m_maximumTimeout = 1000;
+
+    bool m_hasSamples = false;
+    double m_srtt = 0;
+    double m_rttvar = 0;
+    int m_consecutiveTimeouts = 0;
+};
+
+#endif // MODBUSRTTESTIMATOR_H
@@ -0,0 +1,115 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbustimeoutwheel.h"
+#include "extern-plugininfo.h"
+
+ModbusTimeoutWheel::ModbusTimeoutWheel(int resolution, QObject *parent) :
+    QObject(parent),
+    m_resolution(qMax(1, resolution)),
+    m_slots(SlotCount)
+{
+    m_timer = new QTimer(this);
+    m_timer->setInterval(m_resolution);
+    connect(m_timer, &QTimer::timeout, this, &ModbusTimeoutWheel::onTick);
+    m_clock.start();
+}
+
+void ModbusTimeoutWheel::track(QModbusReply *reply, int timeout)
+{
+    if (!reply || reply->isFinished())
+        return;
+
+    // The timer only runs while transactions are outstanding
+    if (!m_timer->isActive()) {
+        m_processedTick = currentTick();
+        m_timer->start();
+    }
+
+    Entry entry;
+    entry.reply = reply;
+    entry.deadline = qMax(currentTick(), m_processedTick) + qMax(1, (timeout + m_resolution - 1) / m_resolution);
+    entry.timeout = timeout;
+    m_slots[entry.deadline % SlotCount].append(entry);
+    m_entryCount++;
+}
+
+int ModbusTimeoutWheel::pendingCount() const
+{
+    int count = 0;
+    foreach (const QList<Entry> &slot, m_slots) {
+        foreach (const Entry &entry, slot) {
+            if (entry.reply && !entry.reply->isFinished())
+                count++;
+        }
+    }
+    return count;
+}
+
+int ModbusTimeoutWheel::timeoutCount() const
+{
+    return m_timeoutCount;
+}
+
+qint64 ModbusTimeoutWheel::currentTick() const
+{
+    return m_clock.elapsed() / m_resolution;
+}
+
+void ModbusTimeoutWheel::onTick()
+{
+    // Catch up on all slots passed since the last tick, a late timer must not
+    // extend the deadlines
+    qint64 now = currentTick();
+    while (m_processedTick < now) {
+        m_processedTick++;
+        QList<Entry> &slot = m_slots[m_processedTick % SlotCount];
+        for (int i = 0; i < slot.count(); ) {
+            const Entry entry = slot.at(i);
+            if (entry.reply && !entry.reply->isFinished() && entry.deadline > m_processedTick) {
+                i++; // due in a later round of the wheel
+                continue;
+            }
+            slot.removeAt(i);
+            m_entryCount--;
+            if (!entry.reply || entry.reply->isFinished())
+                continue;
+
+            m_timeoutCount++;
+            if (m_timeoutCount == 1 || m_timeoutCount % 100 == 0)
+                qCWarning(dcUniPi()) << "Modbus response timeout after" << entry.timeout << "ms, timeouts:" << m_timeoutCount;
+            // Emits finished(), the owner reports the failure and deletes the reply
+            entry.reply->setError(QModbusDevice::TimeoutError, tr("Response timeout"));
+        }
+    }
+
+    if (m_entryCount == 0)
+        m_timer->stop();
+}
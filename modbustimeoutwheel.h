@@ -0,0 +1,79 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSTIMEOUTWHEEL_H
+#define MODBUSTIMEOUTWHEEL_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QVector>
+#include <QModbusReply>
+
+// Response deadlines of all outstanding transactions of one bus, kept in a
+// hashed timer wheel driven by a single timer. A reply that misses its
+// deadline is finished with a TimeoutError, so its owner sees the failure
+// through the regular finished() handling.
+class ModbusTimeoutWheel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ModbusTimeoutWheel(int resolution = 50, QObject *parent = nullptr);
+
+    void track(QModbusReply *reply, int timeout);
+
+    int pendingCount() const;
+    int timeoutCount() const;
+
+private:
+    struct Entry {
+        QPointer<QModbusReply> reply;
+        qint64 deadline;
+        int timeout;
+    };
+
+    static const int SlotCount = 64;
+
+    int m_resolution = 50;
+    QTimer *m_timer = nullptr;
+    QElapsedTimer m_clock;
+    qint64 m_processedTick = 0;
+    QVector<QList<Entry> > m_slots;
+    int m_entryCount = 0;
+    int m_timeoutCount = 0;
+
+    qint64 currentTick() const;
+
+private slots:
+    void onTick();
+};
+
+#endif // MODBUSTIMEOUTWHEEL_H
@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbustransactionwindow.h"
+
+ModbusTransactionWindow::ModbusTransactionWindow(QObject *parent) :
+    QObject(parent)
+{
+
+}
+
+void ModbusTransactionWindow::setSize(int size)
+{
+    int oldSize = m_size;
+    m_size = qMax(1, size);
+    if (m_size > oldSize)
+        emit available();
+}
+
+int ModbusTransactionWindow::size() const
+{
+    return m_size;
+}
+
+bool ModbusTransactionWindow::isFull() const
+{
+    return m_pendingCount >= m_size;
+}
+
+int ModbusTransactionWindow::pendingCount() const
+{
+    return m_pendingCount;
+}
+
+void ModbusTransactionWindow::track(QModbusReply *reply)
+{
+    m_pendingCount++;
+    connect(reply, &QModbusReply::destroyed, this, [this] {
+        m_pendingCount--;
+        emit available();
+    });
+}
@@ -0,0 +1,62 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSTRANSACTIONWINDOW_H
+#define MODBUSTRANSACTIONWINDOW_H
+
+#include <QObject>
+#include <QModbusReply>
+
+// Transactions in flight on one modbus client. All devices sending through
+// the client share the window, so its size limits what the server sees.
+class ModbusTransactionWindow : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ModbusTransactionWindow(QObject *parent = nullptr);
+
+    void setSize(int size);
+    int size() const;
+
+    bool isFull() const;
+    int pendingCount() const;
+
+    // Counts the reply as in flight until it is destroyed
+    void track(QModbusReply *reply);
+
+signals:
+    void available();
+
+private:
+    int m_size = 1;
+    int m_pendingCount = 0;
+};
+
+#endif // MODBUSTRANSACTIONWINDOW_H
@@ -0,0 +1,150 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusvaluecodec.h"
+
+#include <QRegExp>
+#include <QtMath>
+#include <cstring>
+
+static double decodeWord(const quint16 *words)
+{
+    return words[0];
+}
+
+static double decodeDWordHighWordFirst(const quint16 *words)
+{
+    return (static_cast<quint32>(words[0]) << 16) | words[1];
+}
+
+static double decodeDWordLowWordFirst(const quint16 *words)
+{
+    return (static_cast<quint32>(words[1]) << 16) | words[0];
+}
+
+static double toReal(quint32 bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static double decodeRealHighWordFirst(const quint16 *words)
+{
+    return toReal((static_cast<quint32>(words[0]) << 16) | words[1]);
+}
+
+static double decodeRealLowWordFirst(const quint16 *words)
+{
+    return toReal((static_cast<quint32>(words[1]) << 16) | words[0]);
+}
+
+ModbusValueCodec::ModbusValueCodec() :
+    m_decode(decodeWord)
+{
+}
+
+ModbusValueCodec::ModbusValueCodec(const Format &format, WordOrder wordOrder) :
+    m_decode(decodeWord),
+    m_dataType(format.dataType),
+    m_wordOrder(wordOrder),
+    m_scale(format.scale),
+    m_offset(format.offset),
+    m_wordCount(wordCount(format.dataType))
+{
+    switch (m_dataType) {
+    case DWord:
+        m_decode = (wordOrder == HighWordFirst) ? decodeDWordHighWordFirst : decodeDWordLowWordFirst;
+        break;
+    case Real:
+        m_decode = (wordOrder == HighWordFirst) ? decodeRealHighWordFirst : decodeRealLowWordFirst;
+        break;
+    case Word:
+    case MixedBits:
+        m_decode = decodeWord;
+        break;
+    }
+}
+
+QVector<quint16> ModbusValueCodec::encode(double value) const
+{
+    double raw = (value - m_offset) / m_scale;
+    quint32 bits = 0;
+
+    switch (m_dataType) {
+    case Word:
+    case MixedBits:
+        return QVector<quint16>() << static_cast<quint16>(qRound64(qBound(0.0, raw, 65535.0)));
+    case DWord:
+        bits = static_cast<quint32>(qRound64(qBound(0.0, raw, 4294967295.0)));
+        break;
+    case Real: {
+        float real = static_cast<float>(raw);
+        std::memcpy(&bits, &real, sizeof(bits));
+        break;
+    }
+    }
+
+    if (m_wordOrder == HighWordFirst)
+        return QVector<quint16>() << static_cast<quint16>(bits >> 16) << static_cast<quint16>(bits & 0xffff);
+
+    return QVector<quint16>() << static_cast<quint16>(bits & 0xffff) << static_cast<quint16>(bits >> 16);
+}
+
+ModbusValueCodec::Format ModbusValueCodec::format(const QString &dataType, const QString &description)
+{
+    Format format;
+    if (dataType.compare("DWord", Qt::CaseInsensitive) == 0) {
+        format.dataType = DWord;
+    } else if (dataType.compare("Real", Qt::CaseInsensitive) == 0 || dataType.compare("Float", Qt::CaseInsensitive) == 0) {
+        format.dataType = Real;
+    } else if (dataType.compare("MixedBits", Qt::CaseInsensitive) == 0) {
+        format.dataType = MixedBits;
+    }
+
+    // Raw ranges are documented like "(0..4000 ~ 0..10V)"
+    QRegExp range("\\((-?[\\d.]+)\\.\\.(-?[\\d.]+)\\s*~\\s*(-?[\\d.]+)\\.\\.(-?[\\d.]+)");
+    if (range.indexIn(description) >= 0) {
+        double rawMin = range.cap(1).toDouble();
+        double rawMax = range.cap(2).toDouble();
+        double min = range.cap(3).toDouble();
+        double max = range.cap(4).toDouble();
+        if (rawMax != rawMin) {
+            format.scale = (max - min) / (rawMax - rawMin);
+            format.offset = min - rawMin * format.scale;
+        }
+    }
+    return format;
+}
+
+int ModbusValueCodec::wordCount(DataType dataType)
+{
+    return (dataType == DWord || dataType == Real) ? 2 : 1;
+}
@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSVALUECODEC_H
+#define MODBUSVALUECODEC_H
+
+#include <QString>
+#include <QVector>
+
+class ModbusValueCodec
+{
+public:
+    enum DataType {
+        Word,
+        DWord,
+        Real,
+        MixedBits
+    };
+
+    enum WordOrder {
+        HighWordFirst,
+        LowWordFirst
+    };
+
+    // Data type and linear scaling of a register as described in the map
+    struct Format {
+        DataType dataType = Word;
+        double scale = 1.0;
+        double offset = 0.0;
+    };
+
+    ModbusValueCodec();
+    ModbusValueCodec(const Format &format, WordOrder wordOrder);
+
+    int wordCount() const { return m_wordCount; }
+    double decode(const quint16 *words) const { return m_decode(words) * m_scale + m_offset; }
+    QVector<quint16> encode(double value) const;
+
+    static Format format(const QString &dataType, const QString &description);
+    static int wordCount(DataType dataType);
+
+private:
+    typedef double (*DecodeFunction)(const quint16 *words);
+
+    DecodeFunction m_decode;
+    DataType m_dataType = Word;
+    WordOrder m_wordOrder = HighWordFirst;
+    double m_scale = 1.0;
+    double m_offset = 0.0;
+    int m_wordCount = 1;
+};
+
+#endif // MODBUSVALUECODEC_H
@@ -0,0 +1,193 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusvalueimage.h"
+
+#include <cstring>
+
+void ModbusValueImage::clear()
+{
+    for (int i = 0; i <= QModbusDataUnit::HoldingRegisters; i++) {
+        m_images[i] = Image();
+    }
+}
+
+void ModbusValueImage::invalidate()
+{
+    for (int i = 0; i <= QModbusDataUnit::HoldingRegisters; i++) {
+        m_images[i].valid.fill(0);
+    }
+}
+
+bool ModbusValueImage::isBitType(QModbusDataUnit::RegisterType registerType)
+{
+    return registerType == QModbusDataUnit::Coils || registerType == QModbusDataUnit::DiscreteInputs;
+}
+
+void ModbusValueImage::reserve(QModbusDataUnit::RegisterType registerType, int address, int count)
+{
+    if (registerType <= QModbusDataUnit::Invalid || registerType > QModbusDataUnit::HoldingRegisters || address < 0 || count <= 0)
+        return;
+
+    Image &image = m_images[registerType];
+    int first = address;
+    int last = address + count;
+    if (image.size > 0) {
+        first = qMin(first, image.baseAddress);
+        last = qMax(last, image.baseAddress + image.size);
+        if (first == image.baseAddress && last == image.baseAddress + image.size)
+            return;
+    }
+
+    // Regrow and move the known values, this only happens while the plans are built
+    Image resized;
+    resized.baseAddress = first;
+    resized.size = last - first;
+    int words = (resized.size + 63) / 64;
+    resized.valid.fill(0, words);
+    if (isBitType(registerType)) {
+        resized.bits.fill(0, words);
+    } else {
+        resized.registers.fill(0, resized.size);
+    }
+
+    for (int i = 0; i < image.size; i++) {
+        if (!(image.valid.at(i / 64) & (Q_UINT64_C(1) << (i % 64))))
+            continue;
+        int index = image.baseAddress + i - first;
+        resized.valid[index / 64] |= (Q_UINT64_C(1) << (index % 64));
+        if (isBitType(registerType)) {
+            if (image.bits.at(i / 64) & (Q_UINT64_C(1) << (i % 64)))
+                resized.bits[index / 64] |= (Q_UINT64_C(1) << (index % 64));
+        } else {
+            resized.registers[index] = image.registers.at(i);
+        }
+    }
+    image = resized;
+}
+
+bool ModbusValueImage::update(const QModbusDataUnit &unit, QVector<quint16> &changedBits)
+{
+    QModbusDataUnit::RegisterType registerType = unit.registerType();
+    int count = static_cast<int>(unit.valueCount());
+    changedBits.fill(0, count);
+    if (registerType <= QModbusDataUnit::Invalid || registerType > QModbusDataUnit::HoldingRegisters || count == 0)
+        return false;
+
+    reserve(registerType, unit.startAddress(), count);
+    Image &image = m_images[registerType];
+    const QVector<quint16> values = unit.values();
+    int offset = unit.startAddress() - image.baseAddress;
+    bool changed = false;
+
+    if (isBitType(registerType)) {
+        // Pack the response into 64 bit words and diff whole words against the image
+        int firstWord = offset / 64;
+        int lastWord = (offset + count - 1) / 64;
+        for (int word = firstWord; word <= lastWord; word++) {
+            quint64 mask = 0;
+            quint64 newBits = 0;
+            int wordStart = word * 64;
+            int from = qMax(offset, wordStart);
+            int to = qMin(offset + count, wordStart + 64);
+            for (int index = from; index < to; index++) {
+                quint64 bit = Q_UINT64_C(1) << (index - wordStart);
+                mask |= bit;
+                if (values.at(index - offset))
+                    newBits |= bit;
+            }
+
+            quint64 diff = ((image.bits.at(word) ^ newBits) | ~image.valid.at(word)) & mask;
+            image.bits[word] = (image.bits.at(word) & ~mask) | newBits;
+            image.valid[word] |= mask;
+            if (!diff)
+                continue;
+
+            changed = true;
+            for (int index = from; index < to; index++) {
+                if (diff & (Q_UINT64_C(1) << (index - wordStart)))
+                    changedBits[index - offset] = 1;
+            }
+        }
+        return changed;
+    }
+
+    // Registers: skip the whole response if it is known and unchanged
+    bool allValid = true;
+    for (int index = offset; index < offset + count; index++) {
+        if (!(image.valid.at(index / 64) & (Q_UINT64_C(1) << (index % 64)))) {
+            allValid = false;
+            break;
+        }
+    }
+    if (allValid && std::memcmp(image.registers.constData() + offset, values.constData(), count * sizeof(quint16)) == 0)
+        return false;
+
+    for (int i = 0; i < count; i++) {
+        int index = offset + i;
+        quint64 validBit = Q_UINT64_C(1) << (index % 64);
+        if (image.valid.at(index / 64) & validBit) {
+            changedBits[i] = image.registers.at(index) ^ values.at(i);
+        } else {
+            changedBits[i] = 0xffff;
+            image.valid[index / 64] |= validBit;
+        }
+        image.registers[index] = values.at(i);
+        if (changedBits.at(i))
+            changed = true;
+    }
+    return changed;
+}
+
+bool ModbusValueImage::isValid(QModbusDataUnit::RegisterType registerType, int address) const
+{
+    if (registerType <= QModbusDataUnit::Invalid || registerType > QModbusDataUnit::HoldingRegisters)
+        return false;
+
+    const Image &image = m_images[registerType];
+    int index = address - image.baseAddress;
+    if (index < 0 || index >= image.size)
+        return false;
+
+    return image.valid.at(index / 64) & (Q_UINT64_C(1) << (index % 64));
+}
+
+quint16 ModbusValueImage::value(QModbusDataUnit::RegisterType registerType, int address) const
+{
+    if (!isValid(registerType, address))
+        return 0;
+
+    const Image &image = m_images[registerType];
+    int index = address - image.baseAddress;
+    if (isBitType(registerType))
+        return (image.bits.at(index / 64) >> (index % 64)) & 1;
+
+    return image.registers.at(index);
+}
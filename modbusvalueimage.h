@@ -0,0 +1,67 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MODBUSVALUEIMAGE_H
+#define MODBUSVALUEIMAGE_H
+
+#include <QVector>
+#include <QModbusDataUnit>
+
+class ModbusValueImage
+{
+public:
+    void clear();
+    void invalidate();
+    void reserve(QModbusDataUnit::RegisterType registerType, int address, int count);
+
+    // Stores the values of a response. changedBits receives one entry per value,
+    // the xor with the previous value or 0xffff if it was never read. Returns
+    // false if nothing changed.
+    bool update(const QModbusDataUnit &unit, QVector<quint16> &changedBits);
+
+    bool isValid(QModbusDataUnit::RegisterType registerType, int address) const;
+    quint16 value(QModbusDataUnit::RegisterType registerType, int address) const;
+
+private:
+    struct Image {
+        int baseAddress = 0;
+        int size = 0;
+        QVector<quint64> bits;      // coil values, one bit per coil
+        QVector<quint16> registers;
+        QVector<quint64> valid;     // one bit per address
+    };
+
+    // Indexed by QModbusDataUnit::RegisterType, Invalid to HoldingRegisters
+    Image m_images[QModbusDataUnit::HoldingRegisters + 1];
+
+    static bool isBitType(QModbusDataUnit::RegisterType registerType);
+};
+
+#endif // MODBUSVALUEIMAGE_H
@@ -29,14 +29,19 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "neuron.h"
+#include "modbusreadplan.h"
 #include "extern-plugininfo.h"
 
-#include <QFile>
-#include <QTextStream>
-#include <QStandardPaths>
+#include <QSet>
+#include <QMap>
+#include <QDateTime>
+#include <QElapsedTimer>
 
-Neuron::Neuron(NeuronTypes neuronType, QModbusTcpClient *modbusInterface,  QObject *parent) :
+Neuron::Neuron(NeuronTypes neuronType, QModbusTcpClient *modbusInterface, ModbusRttEstimator *rttEstimator, ModbusTimeoutWheel *timeoutWheel, ModbusTransactionWindow *transactionWindow, QObject *parent) :
     QObject(parent),
+    m_rttEstimator(rttEstimator),
+    m_transactionWindow(transactionWindow),
+    m_timeoutWheel(timeoutWheel),
     m_modbusInterface(modbusInterface),
     m_neuronType(neuronType)
 {
@@ -50,23 +55,34 @@ Neuron::Neuron(NeuronTypes neuronType, QModbusTcpClient *modbusInterface,  QObje
     m_outputPollingTimer->setTimerType(Qt::TimerType::PreciseTimer);
     m_outputPollingTimer->setInterval(1000);
 
+    m_counterPollingTimer = new QTimer(this);
+    connect(m_counterPollingTimer, &QTimer::timeout, this, &Neuron::onCounterPollingTimer);
+    m_counterPollingTimer->setTimerType(Qt::TimerType::PreciseTimer);
+    m_counterPollingTimer->setInterval(m_counterPollingInterval);
+
+    // Another Neuron's transaction finished, the window has room again
+    connect(m_transactionWindow, &ModbusTransactionWindow::available, this, &Neuron::sendNextRequests);
+
     if (m_modbusInterface->state() == QModbusDevice::State::ConnectedState) {
         m_inputPollingTimer->start();
         m_outputPollingTimer->start();
+        m_counterPollingTimer->start();
     }
 
     connect(m_modbusInterface, &QModbusDevice::stateChanged, this, [this] (QModbusDevice::State state) {
         if (state == QModbusDevice::State::ConnectedState) {
-            if (m_inputPollingTimer)
-                m_inputPollingTimer->start();
-            if (m_outputPollingTimer)
-                m_outputPollingTimer->start();
+            startResync();
             emit connectionStateChanged(true);
         } else {
             if (m_inputPollingTimer)
                 m_inputPollingTimer->stop();
             if (m_outputPollingTimer)
                 m_outputPollingTimer->stop();
+            if (m_counterPollingTimer)
+                m_counterPollingTimer->stop();
+            m_readRequestQueue.clear();
+            m_resyncRequestQueue.clear();
+            m_resyncPending = 0;
             emit connectionStateChanged(false);
         }
     });
@@ -83,6 +99,11 @@ Neuron::~Neuron(){
         m_outputPollingTimer->deleteLater();
         m_outputPollingTimer = nullptr;
     }
+    if (m_counterPollingTimer) {
+        m_counterPollingTimer->stop();
+        m_counterPollingTimer->deleteLater();
+        m_counterPollingTimer = nullptr;
+    }
 }
 
 bool Neuron::init()
@@ -90,6 +111,8 @@ bool Neuron::init()
     if (!loadModbusMap()) {
         return false;
     }
+    buildRegisterTable();
+    buildReadPlans();
 
     if (!m_modbusInterface) {
         qWarning(dcUniPi()) << "Modbus TCP interface not available";
@@ -140,27 +163,32 @@ QString Neuron::type()
 
 QList<QString> Neuron::digitalInputs()
 {
-    return m_modbusDigitalInputRegisters.keys();
+    return m_layout->digitalInputRegisters.keys();
 }
 
 QList<QString> Neuron::digitalOutputs()
 {
-    return m_modbusDigitalOutputRegisters.keys();
+    return m_layout->digitalOutputRegisters.keys();
+}
+
+QList<QString> Neuron::pwmOutputs()
+{
+    return m_layout->pwmDutyCycleRegisters.keys();
 }
 
 QList<QString> Neuron::analogInputs()
 {
-    return m_modbusAnalogInputRegisters.keys();
+    return m_layout->analogInputRegisters.keys();
 }
 
 QList<QString> Neuron::analogOutputs()
 {
-    return m_modbusAnalogOutputRegisters.keys();
+    return m_layout->analogOutputRegisters.keys();
 }
 
 QList<QString> Neuron::userLEDs()
 {
-    return m_modbusUserLEDRegisters.keys();
+    return m_layout->userLEDRegisters.keys();
 }
 
 
@@ -234,45 +262,6 @@ bool Neuron::loadModbusMap()
         break;
     }
 
-    foreach(QString relativeFilePath, fileCoilList) {
-        QString absoluteFilePath = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation).last() + "/nymea/modbus" + relativeFilePath;
-        qDebug(dcUniPi()) << "Open CSV File:" << absoluteFilePath;
-        QFile *csvFile = new QFile(absoluteFilePath);
-        if (!csvFile->open(QIODevice::ReadOnly | QIODevice::Text)) {
-            qCWarning(dcUniPi()) << csvFile->errorString() << "Path:" << absoluteFilePath;
-            csvFile->deleteLater();
-            return false;
-        }
-        QTextStream *textStream = new QTextStream(csvFile);
-        while (!textStream->atEnd()) {
-            QString line = textStream->readLine();
-            QStringList list = line.split(',');
-            if (list.length() <= 4) {
-                qCWarning(dcUniPi()) << "currupted CSV file:" << csvFile->fileName();
-                csvFile->deleteLater();
-                return false;
-            }
-            if (list[4] == "Basic") {
-                QString circuit = list[3].split(" ").last();
-                if (list[3].contains("Digital Input", Qt::CaseSensitivity::CaseInsensitive)) {
-                    m_modbusDigitalInputRegisters.insert(circuit, list[0].toInt());
-                    qDebug(dcUniPi()) << "Found input register" << circuit << list[0].toInt();
-                } else if (list[3].contains("Digital Output", Qt::CaseSensitivity::CaseInsensitive)) {
-                    m_modbusDigitalOutputRegisters.insert(circuit, list[0].toInt());
-                    qDebug(dcUniPi()) << "Found output register" << circuit << list[0].toInt();
-                } else if (list[3].contains("Relay Output", Qt::CaseSensitivity::CaseInsensitive)) {
-                    m_modbusDigitalOutputRegisters.insert(circuit, list[0].toInt());
-                    qDebug(dcUniPi()) << "Found relay register" << circuit << list[0].toInt();
-                } else if (list[3].contains("User Programmable LED", Qt::CaseSensitivity::CaseInsensitive)) {
-                    m_modbusUserLEDRegisters.insert(circuit, list[0].toInt());
-                    qDebug(dcUniPi()) << "Found user programmable led" << circuit << list[0].toInt();
-                }
-            }
-        }
-        csvFile->close();
-        csvFile->deleteLater();
-    }
-
     switch (m_neuronType) {
     case NeuronTypes::S103:
         fileRegisterList.append(QString("/Neuron_S103/Neuron_S103-Registers-group-1.csv"));
@@ -337,77 +326,114 @@ bool Neuron::loadModbusMap()
         fileRegisterList.append(QString("/Neuron_L533/Neuron_L533-Registers-group-3.csv"));
         break;
     }
-    foreach (QString relativeFilePath, fileRegisterList) {
-        QString absoluteFilePath = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation).last() + "/nymea/modbus" + relativeFilePath;
-        qDebug(dcUniPi()) << "Open CSV File:" << absoluteFilePath;
-        QFile *csvFile = new QFile(absoluteFilePath);
-        if (!csvFile->open(QIODevice::ReadOnly | QIODevice::Text)) {
-            qCWarning(dcUniPi()) << csvFile->errorString() << "Path:" << absoluteFilePath;
-            csvFile->deleteLater();
-            return false;
-        }
-        QTextStream *textStream = new QTextStream(csvFile);
-        while (!textStream->atEnd()) {
-            QString line = textStream->readLine();
-            QStringList list = line.split(',');
-            if (list.length() <= 5) {
-                qCWarning(dcUniPi()) << "currupted CSV file:" << csvFile->fileName();
-                csvFile->deleteLater();
-                return false;
-            }
-            if (list.last() == "Basic") {
-                QString circuit = list[5].split(" ").last();
-                if (list[5].contains("Analog Input Value", Qt::CaseSensitivity::CaseInsensitive)) {
-                    m_modbusAnalogInputRegisters.insert(circuit, list[0].toInt());
-                    qDebug(dcUniPi()) << "Found analog input register" << circuit << list[0].toInt();
-                } else if (list[5].contains("Analog Output Value", Qt::CaseSensitivity::CaseInsensitive)) {
-                    m_modbusAnalogOutputRegisters.insert(circuit, list[0].toInt());
-                    qDebug(dcUniPi()) << "Found analog output register" << circuit << list[0].toInt();
-                }
-            }
+
+    QSharedPointer<const ModbusMapLayout> layout = ModbusMap::layout("Neuron_" + type(), fileCoilList, fileRegisterList);
+    if (!layout)
+        return false;
+    m_layout = layout;
+
+    qCDebug(dcUniPi()) << "Neuron" << type() << "map:" << m_layout->digitalInputRegisters.count() << "digital inputs," << m_layout->digitalOutputRegisters.count() << "digital outputs,"
+                       << m_layout->analogInputRegisters.count() << "analog inputs," << m_layout->analogOutputRegisters.count() << "analog outputs";
+    return true;
+}
+
+bool Neuron::enqueueWriteRequest(Request request)
+{
+    // Last write wins: a newer value for a register that is still waiting in the
+    // queue replaces the pending one and takes over its place and its action
+    for (int i = 0; i < m_writeRequestQueue.length(); i++) {
+        const Request &pending = m_writeRequestQueue.at(i);
+        if (pending.data.registerType() == request.data.registerType() &&
+                pending.data.startAddress() == request.data.startAddress() &&
+                pending.data.valueCount() == request.data.valueCount()) {
+            request.supersededIds = pending.supersededIds;
+            request.supersededIds.append(pending.id);
+            m_writeRequestQueue.replace(i, request);
+            return true;
         }
-        csvFile->close();
-        csvFile->deleteLater();
     }
+
+    if (m_writeRequestQueue.length() > 100) {
+        return false;
+    }
+    m_writeRequestQueue.append(request);
     return true;
 }
 
+void Neuron::finishWriteRequest(const Request &request, bool success)
+{
+    foreach (const QUuid &requestId, request.supersededIds) {
+        completeRequest(requestId, success);
+    }
+    completeRequest(request.id, success);
+}
+
+void Neuron::completeRequest(const QUuid &requestId, bool success)
+{
+    if (!m_requestGroups.contains(requestId)) {
+        emit requestExecuted(requestId, success);
+        return;
+    }
+
+    // A multi-output write completes once all of its transactions are done
+    QUuid groupId = m_requestGroups.take(requestId);
+    bool groupSuccess = m_requestGroupResults.value(groupId, true) && success;
+    if (--m_requestGroupPending[groupId] > 0) {
+        m_requestGroupResults.insert(groupId, groupSuccess);
+        return;
+    }
+    m_requestGroupPending.remove(groupId);
+    m_requestGroupResults.remove(groupId);
+    emit requestExecuted(groupId, groupSuccess);
+}
 
 bool Neuron::modbusWriteRequest(const Request &request)
 {
     if (!m_modbusInterface)
         return false;
 
+    applyResponseTimeout();
     if (QModbusReply *reply = m_modbusInterface->sendWriteRequest(request.data, m_slaveAddress)) {
         if (!reply->isFinished()) {
             connect(reply, &QModbusReply::finished, reply, &QModbusReply::deleteLater);
+            m_transactionWindow->track(reply);
             connect(reply, &QModbusReply::finished, this, [reply, request, this] {
 
-                if (!m_writeRequestQueue.isEmpty()) {
-                    modbusWriteRequest(m_writeRequestQueue.takeFirst());
-                }
-
                 if (reply->error() == QModbusDevice::NoError) {
-                    requestExecuted(request.id, true);
-                    const QModbusDataUnit unit = reply->result();
+                    finishWriteRequest(request, true);
+                    QList<QModbusDataUnit> configReads = m_configRegisters.handleWrite(request.data, true);
+                    if (!configReads.isEmpty())
+                        sendReadRequests(configReads);
+                    const QModbusDataUnit unit = request.data;
                     int modbusAddress = unit.startAddress();
-                    if(m_modbusDigitalOutputRegisters.values().contains(modbusAddress)){
-                        QString circuit = m_modbusDigitalOutputRegisters.key(modbusAddress);
-                        emit digitalOutputStatusChanged(circuit, unit.value(0));
-                    } else if(m_modbusAnalogOutputRegisters.values().contains(modbusAddress)){
-                        QString circuit = m_modbusAnalogOutputRegisters.key(modbusAddress);
-                        emit analogOutputStatusChanged(circuit, unit.value(0));
-                    } else if(m_modbusUserLEDRegisters.values().contains(modbusAddress)){
-                        QString circuit = m_modbusUserLEDRegisters.key(modbusAddress);
-                        emit userLEDStatusChanged(circuit, unit.value(0));
+                    const ModbusRegisterTable::Circuit &circuit = m_registerTable.circuit(unit.registerType(), modbusAddress);
+                    if (unit.registerType() == QModbusDataUnit::RegisterType::Coils && unit.valueCount() > 1) {
+                        for (int i = 0; i < static_cast<int>(unit.valueCount()); i++) {
+                            const ModbusRegisterTable::Circuit &outputCircuit = m_registerTable.circuit(unit.registerType(), modbusAddress + i);
+                            if (outputCircuit.type == ModbusRegisterTable::DigitalOutput)
+                                queueChange(ModbusRegisterTable::DigitalOutput, outputCircuit.name, unit.value(i));
+                        }
+                    } else if (unit.registerType() == QModbusDataUnit::RegisterType::HoldingRegisters && m_layout->packedDigitalOutputBits.contains(modbusAddress)) {
+                        if (m_valueImage.update(unit, m_changedBits))
+                            decodePackedRegister(modbusAddress, unit.value(0), m_changedBits.at(0));
+                    } else if (circuit.type == ModbusRegisterTable::DigitalOutput) {
+                        queueChange(ModbusRegisterTable::DigitalOutput, circuit.name, unit.value(0));
+                    } else if (circuit.type == ModbusRegisterTable::AnalogOutput && static_cast<int>(unit.valueCount()) >= circuit.codec.wordCount()) {
+                        queueChange(ModbusRegisterTable::AnalogOutput, circuit.name, circuit.codec.decode(unit.values().constData()));
+                    } else if (circuit.type == ModbusRegisterTable::PwmOutput) {
+                        queueChange(ModbusRegisterTable::PwmOutput, circuit.name, circuit.codec.decode(unit.values().constData()));
+                    } else if (circuit.type == ModbusRegisterTable::UserLED) {
+                        queueChange(ModbusRegisterTable::UserLED, circuit.name, unit.value(0));
                     }
+                    publishChanges();
                 } else {
-                    requestExecuted(request.id, false);
+                    finishWriteRequest(request, false);
+                    m_configRegisters.handleWrite(request.data, false);
                     qCWarning(dcUniPi()) << "Write response error:" << reply->error();
                     emit requestError(request.id, reply->errorString());
                 }
             });
-            QTimer::singleShot(m_responseTimeoutTime, reply, &QModbusReply::deleteLater);
+            trackResponseTime(reply);
         } else {
             delete reply; // broadcast replies return immediately
             return false;
@@ -419,67 +445,110 @@ bool Neuron::modbusWriteRequest(const Request &request)
     return true;
 }
 
+void Neuron::applyResponseTimeout()
+{
+    // The client is shared, a new timeout re-arms the timers of all transactions
+    // in flight. It only follows changes of the estimate by more than a quarter.
+    int timeout = m_rttEstimator->timeout();
+    if (qAbs(timeout - m_modbusInterface->timeout()) > m_modbusInterface->timeout() / 4)
+        m_modbusInterface->setTimeout(timeout);
+    if (m_modbusInterface->numberOfRetries() != m_rttEstimator->retries())
+        m_modbusInterface->setNumberOfRetries(m_rttEstimator->retries());
+}
+
+void Neuron::trackResponseTime(QModbusReply *reply)
+{
+    QElapsedTimer clock;
+    clock.start();
+    int timeout = m_modbusInterface->timeout();
+    connect(reply, &QModbusReply::finished, this, [this, reply, clock, timeout] {
+        double elapsed = clock.nsecsElapsed() / 1000000.0;
+        if (reply->error() == QModbusDevice::TimeoutError) {
+            m_rttEstimator->addTimeout();
+        } else if ((reply->error() == QModbusDevice::NoError || reply->error() == QModbusDevice::ProtocolError) && elapsed < timeout) {
+            // Retried transactions are ambiguous and give no sample
+            m_rttEstimator->addSample(elapsed);
+        }
+    });
+    // The client retries on its own, the wheel only catches replies it never finishes
+    m_timeoutWheel->track(reply, timeout * (m_modbusInterface->numberOfRetries() + 1) + 100);
+}
 
-bool Neuron::modbusReadRequest(const QModbusDataUnit &request)
+bool Neuron::modbusReadRequest(const QModbusDataUnit &request, bool resync)
 {
     if (!m_modbusInterface)
         return false;
 
+    applyResponseTimeout();
     if (QModbusReply *reply = m_modbusInterface->sendReadRequest(request, m_slaveAddress)) {
         if (!reply->isFinished()) {
             connect(reply, &QModbusReply::finished, reply, &QModbusReply::deleteLater);
+            m_transactionWindow->track(reply);
             connect(reply, &QModbusReply::finished, this, [reply, this] {
 
                 int modbusAddress = 0;
 
                 if (reply->error() == QModbusDevice::NoError) {
                     const QModbusDataUnit unit = reply->result();
+                    foreach (const QModbusDataUnit &configWrite, m_configRegisters.handleRead(unit)) {
+                        Request configRequest;
+                        configRequest.id = QUuid::createUuid();
+                        configRequest.data = configWrite;
+                        enqueueWriteRequest(configRequest);
+                    }
+                    // Unchanged holding register blocks are still decoded for the counters
+                    if (!m_valueImage.update(unit, m_changedBits) && unit.registerType() != QModbusDataUnit::RegisterType::HoldingRegisters) {
+                        return;
+                    }
 
-                    for (int i = 0; i < static_cast<int>(unit.valueCount()); i++) {
+                    const QVector<quint16> values = unit.values();
+                    for (int i = 0; i < values.count(); i++) {
                         //qCDebug(dcUniPi()) << "Start Address:" << unit.startAddress() << "Register Type:" << unit.registerType() << "Value:" << unit.value(i);
                         modbusAddress = unit.startAddress() + i;
 
-                        if (m_previousModbusRegisterValue.contains(modbusAddress)) {
-                            if (m_previousModbusRegisterValue.value(modbusAddress) == unit.value(i)) {
-                                continue;
-                            } else  {
-                                m_previousModbusRegisterValue.insert(modbusAddress, unit.value(i)); //update existing value
-                            }
-                        } else {
-                            m_previousModbusRegisterValue.insert(modbusAddress, unit.value(i));
+                        const ModbusRegisterTable::Circuit &circuit = m_registerTable.circuit(unit.registerType(), modbusAddress);
+                        int wordCount = circuit.codec.wordCount();
+                        uint16_t changedBits = m_changedBits.at(i);
+                        for (int word = 1; word < wordCount && i + word < m_changedBits.size(); word++) {
+                            changedBits |= m_changedBits.at(i + word);
+                        }
+                        // Counters are reported on every read, their rate depends on the time between reads
+                        if (!changedBits && circuit.type != ModbusRegisterTable::DigitalInputCounter) {
+                            continue;
                         }
-
-                        QString circuit;
                         switch (unit.registerType()) {
                         case QModbusDataUnit::RegisterType::Coils:
-                            if(m_modbusDigitalInputRegisters.values().contains(modbusAddress)){
-                                circuit = m_modbusDigitalInputRegisters.key(modbusAddress);
-                                emit digitalInputStatusChanged(circuit, unit.value(i));
-                            } else if(m_modbusDigitalOutputRegisters.values().contains(modbusAddress)){
-                                circuit = m_modbusDigitalOutputRegisters.key(modbusAddress);
-                                emit digitalOutputStatusChanged(circuit, unit.value(i));
-                            } else if(m_modbusUserLEDRegisters.values().contains(modbusAddress)){
-                                circuit = m_modbusUserLEDRegisters.key(modbusAddress);
-                                emit userLEDStatusChanged(circuit, unit.value(i));
-                            } else {
-                                qCWarning(dcUniPi()) << "Received unrecorgnised modbus register" << modbusAddress;
+                            if (circuit.type == ModbusRegisterTable::DigitalInput) {
+                                queueChange(ModbusRegisterTable::DigitalInput, circuit.name, unit.value(i));
+                            } else if (circuit.type == ModbusRegisterTable::DigitalOutput) {
+                                queueChange(ModbusRegisterTable::DigitalOutput, circuit.name, unit.value(i));
+                            } else if (circuit.type == ModbusRegisterTable::UserLED) {
+                                queueChange(ModbusRegisterTable::UserLED, circuit.name, unit.value(i));
+                            } else if (circuit.type == ModbusRegisterTable::WatchdogReset && unit.value(i)) {
+                                qCWarning(dcUniPi()) << "Neuron" << type() << "was reset by the master watchdog";
+                                queueChange(ModbusRegisterTable::WatchdogReset, circuit.name, 1);
+                                Request clearRequest;
+                                clearRequest.id = QUuid::createUuid();
+                                clearRequest.data = QModbusDataUnit(QModbusDataUnit::RegisterType::Coils, modbusAddress, 1);
+                                clearRequest.data.setValue(0, 0);
+                                enqueueWriteRequest(clearRequest);
                             }
                             break;
 
                         case QModbusDataUnit::RegisterType::HoldingRegisters:
-                            if(m_modbusAnalogOutputRegisters.values().contains(modbusAddress)){
-                                circuit = m_modbusAnalogOutputRegisters.key(modbusAddress);
-                                emit analogOutputStatusChanged(circuit, (unit.value(i) << 16 | unit.value(i+1)));
-                            } else {
-                                qCWarning(dcUniPi()) << "Received unrecognised modbus register" << modbusAddress;
+                            if (m_layout->packedDigitalInputBits.contains(modbusAddress) || m_layout->packedDigitalOutputBits.contains(modbusAddress)) {
+                                decodePackedRegister(modbusAddress, unit.value(i), changedBits);
+                            } else if (circuit.type == ModbusRegisterTable::AnalogOutput && i + wordCount <= values.count()) {
+                                queueChange(ModbusRegisterTable::AnalogOutput, circuit.name, circuit.codec.decode(values.constData() + i));
+                            } else if (circuit.type == ModbusRegisterTable::DigitalInputCounter && i + wordCount <= values.count()) {
+                                queueChange(ModbusRegisterTable::DigitalInputCounter, circuit.name, circuit.codec.decode(values.constData() + i));
+                            } else if (circuit.type == ModbusRegisterTable::PwmOutput) {
+                                queueChange(ModbusRegisterTable::PwmOutput, circuit.name, circuit.codec.decode(values.constData() + i));
                             }
                             break;
                         case QModbusDataUnit::RegisterType::InputRegisters:
-                            if(m_modbusAnalogInputRegisters.values().contains(modbusAddress)){
-                                circuit = m_modbusAnalogInputRegisters.key(modbusAddress);
-                                emit analogInputStatusChanged(circuit, (unit.value(i) << 16 | unit.value(i+1)));
-                            } else {
-                                qCWarning(dcUniPi()) << "Received unrecognised modbus register" << modbusAddress;
+                            if (circuit.type == ModbusRegisterTable::AnalogInput && i + wordCount <= values.count()) {
+                                queueChange(ModbusRegisterTable::AnalogInput, circuit.name, circuit.codec.decode(values.constData() + i));
                             }
                             break;
                         case QModbusDataUnit::RegisterType::DiscreteInputs:
@@ -488,13 +557,22 @@ bool Neuron::modbusReadRequest(const QModbusDataUnit &request)
                             break;
                         }
                     }
+                    publishChanges();
                 } else if (reply->error() == QModbusDevice::ProtocolError) {
                     qCWarning(dcUniPi()) << "Read response error:" << reply->errorString() << reply->rawResult().exceptionCode();
                 } else {
                     qCWarning(dcUniPi()) << "Read response error:" << reply->error() << reply->errorString();
                 }
             });
-            QTimer::singleShot(m_responseTimeoutTime, reply, &QModbusReply::deleteLater);
+            trackResponseTime(reply);
+            if (resync) {
+                // Connected after the response handler, the changes of the reply are queued by then
+                int resyncId = m_resyncId;
+                connect(reply, &QModbusReply::finished, this, [this, resyncId] {
+                    if (resyncId == m_resyncId && m_resyncPending > 0 && --m_resyncPending == 0)
+                        finishResync();
+                });
+            }
         } else {
             delete reply; // broadcast replies return immediately
             return false;
@@ -507,167 +585,318 @@ bool Neuron::modbusReadRequest(const QModbusDataUnit &request)
 }
 
 
-bool Neuron::getInputRegisters(QList<int> registerList)
+void Neuron::setReadGapTolerance(int gapTolerance)
 {
-    if (registerList.isEmpty()) {
-        return true;
+    if (m_readGapTolerance == gapTolerance)
+        return;
+
+    m_readGapTolerance = gapTolerance;
+    buildReadPlans();
+}
+
+void Neuron::setPackedDigitalPolling(bool enabled)
+{
+    if (m_packedDigitalPolling == enabled)
+        return;
+
+    m_packedDigitalPolling = enabled;
+    buildReadPlans();
+}
+
+void Neuron::setAnalogWordOrder(ModbusValueCodec::WordOrder wordOrder)
+{
+    if (m_analogWordOrder == wordOrder)
+        return;
+
+    m_analogWordOrder = wordOrder;
+    buildRegisterTable();
+}
+
+void Neuron::setCounterPollingInterval(int interval)
+{
+    // 0 disables the counter polling
+    m_counterPollingInterval = (interval > 0) ? qMax(10, interval) : 0;
+    if (!m_counterPollingTimer)
+        return;
+
+    if (m_counterPollingInterval == 0) {
+        m_counterPollingTimer->stop();
+        return;
     }
+    m_counterPollingTimer->setInterval(m_counterPollingInterval);
+    if (m_modbusInterface->state() == QModbusDevice::State::ConnectedState)
+        m_counterPollingTimer->start();
+}
 
-    std::sort(registerList.begin(), registerList.end());
-    int previousReg = registerList.first(); //first register to read and starting point to get the following registers
-    int startAddress;
-
-    QHash<int, int> registerGroups;
-
-    foreach (int reg, registerList) {
-        //qDebug(dcUniPi()) << "Register" << reg << "previous Register" << previousReg;
-        if (reg == previousReg) { //first register
-            startAddress = reg;
-            registerGroups.insert(startAddress, 1);
-        } else if (reg == (previousReg + 1)) { //next register in block
-            previousReg = reg;
-            registerGroups.insert(startAddress, (registerGroups.value(startAddress) + 1)); //update block length
-        } else {    // new block
-            startAddress = reg;
-            previousReg = reg;
-            registerGroups.insert(startAddress, 1);
+void Neuron::setWatchdogTimeout(int milliseconds)
+{
+    // Any Modbus transaction with a group restarts its watchdog, the regular
+    // polls keep it alive. 0 leaves the device configuration alone.
+    bool wasEnabled = (m_watchdogTimeout > 0);
+    m_watchdogTimeout = qBound(0, milliseconds, 65535);
+    foreach (int modbusAddress, m_layout->watchdogTimeoutRegisters) {
+        if (m_watchdogTimeout > 0) {
+            m_configRegisters.set(modbusAddress, static_cast<quint16>(m_watchdogTimeout));
+            if (m_modbusInterface && m_modbusInterface->state() == QModbusDevice::State::ConnectedState)
+                sendReadRequests(QList<QModbusDataUnit>() << m_configRegisters.readRequest(modbusAddress));
+        } else {
+            m_configRegisters.unset(modbusAddress);
         }
     }
-
-    foreach (int startAddress, registerGroups.keys()) {
-        QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::InputRegisters, startAddress, registerGroups.value(startAddress));
-        if (m_readRequestQueue.isEmpty()) {
-            modbusReadRequest(request);
-        } else if (m_readRequestQueue.length() > 100) {
-            qCWarning(dcUniPi()) << "Neuron extension: too many pending read requests";
+    // Bit 0 of the status register enables the watchdog
+    foreach (int modbusAddress, m_layout->watchdogStatusRegisters) {
+        if (m_watchdogTimeout > 0 || wasEnabled) {
+            setConfigBit(qMakePair(modbusAddress, 0), m_watchdogTimeout > 0);
         } else {
-            m_readRequestQueue.append(request);
+            m_configRegisters.unset(modbusAddress, 0x0001);
         }
     }
-    return true;
+    buildReadPlans();
 }
 
-bool Neuron::getHoldingRegisters(QList<int> registerList)
+void Neuron::setPwmFrequency(double frequency)
 {
-    if (registerList.isEmpty()) {
-        return true;
+    if (m_layout->pwmPrescalerRegister < 0 || m_layout->pwmCycleLengthRegister < 0 || frequency <= 0)
+        return;
+
+    // f = 48 MHz / ((prescaler + 1) * (cycle length + 1)), a cycle of 1000 steps
+    // is used where the frequency allows it, above that the resolution drops
+    const double clock = 48000000.0;
+    int cycleLength = 999;
+    int prescaler = qRound(clock / (frequency * (cycleLength + 1))) - 1;
+    if (prescaler < 0) {
+        prescaler = 0;
+        cycleLength = qMax(1, qRound(clock / frequency) - 1);
+    }
+    prescaler = qMin(prescaler, 65535);
+    qCDebug(dcUniPi()) << "Neuron" << type() << "PWM frequency" << clock / ((prescaler + 1) * (cycleLength + 1)) << "Hz, prescaler" << prescaler << "cycle length" << cycleLength;
+
+    m_pwmCycleLength = cycleLength;
+    m_configRegisters.set(m_layout->pwmPrescalerRegister, static_cast<quint16>(prescaler));
+    m_configRegisters.set(m_layout->pwmCycleLengthRegister, static_cast<quint16>(cycleLength));
+    if (m_modbusInterface && m_modbusInterface->state() == QModbusDevice::State::ConnectedState) {
+        sendReadRequests(QList<QModbusDataUnit>() << m_configRegisters.readRequest(m_layout->pwmPrescalerRegister)
+                                                  << m_configRegisters.readRequest(m_layout->pwmCycleLengthRegister));
     }
+    buildRegisterTable();
+}
 
-    std::sort(registerList.begin(), registerList.end());
-    int previousReg = registerList.first(); //first register to read and starting point to get the following registers
-    int startAddress;
-
-    QHash<int, int> registerGroups;
-
-    foreach (int reg, registerList) {
-        //qDebug(dcUniPi()) << "Register" << reg << "previous Register" << previousReg;
-        if (reg == previousReg) { //first register
-            startAddress = reg;
-            registerGroups.insert(startAddress, 1);
-        } else if (reg == (previousReg + 1)) { //next register in block
-            previousReg = reg;
-            registerGroups.insert(startAddress, (registerGroups.value(startAddress) + 1)); //update block length
-        } else {    // new block
-            startAddress = reg;
-            previousReg = reg;
-            registerGroups.insert(startAddress, 1);
-        }
+void Neuron::buildRegisterTable()
+{
+    m_registerTable.clear();
+    foreach (const QString &circuit, m_layout->digitalInputRegisters.keys()) {
+        m_registerTable.insert(QModbusDataUnit::RegisterType::Coils, m_layout->digitalInputRegisters.value(circuit), ModbusRegisterTable::DigitalInput, circuit);
+    }
+    foreach (const QString &circuit, m_layout->digitalOutputRegisters.keys()) {
+        m_registerTable.insert(QModbusDataUnit::RegisterType::Coils, m_layout->digitalOutputRegisters.value(circuit), ModbusRegisterTable::DigitalOutput, circuit);
+    }
+    foreach (const QString &circuit, m_layout->userLEDRegisters.keys()) {
+        m_registerTable.insert(QModbusDataUnit::RegisterType::Coils, m_layout->userLEDRegisters.value(circuit), ModbusRegisterTable::UserLED, circuit);
+    }
+    foreach (const QString &circuit, m_layout->analogInputRegisters.keys()) {
+        ModbusValueCodec codec(m_layout->analogFormats.value(circuit), m_analogWordOrder);
+        m_registerTable.insert(QModbusDataUnit::RegisterType::InputRegisters, m_layout->analogInputRegisters.value(circuit), ModbusRegisterTable::AnalogInput, circuit, codec);
+    }
+    foreach (const QString &circuit, m_layout->analogOutputRegisters.keys()) {
+        ModbusValueCodec codec(m_layout->analogFormats.value(circuit), m_analogWordOrder);
+        m_registerTable.insert(QModbusDataUnit::RegisterType::HoldingRegisters, m_layout->analogOutputRegisters.value(circuit), ModbusRegisterTable::AnalogOutput, circuit, codec);
     }
 
-    foreach (int startAddress, registerGroups.keys()) {
-        qDebug(dcUniPi()) << "Register" << startAddress << "length" << registerGroups.value(startAddress);
-        QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, startAddress, registerGroups.value(startAddress));
-        modbusReadRequest(request);
+    // The counters are 32 bit, the firmware stores the low word first
+    ModbusValueCodec::Format counterFormat;
+    counterFormat.dataType = ModbusValueCodec::DWord;
+    ModbusValueCodec counterCodec(counterFormat, ModbusValueCodec::LowWordFirst);
+    foreach (const QString &circuit, m_layout->digitalInputCounterRegisters.keys()) {
+        m_registerTable.insert(QModbusDataUnit::RegisterType::HoldingRegisters, m_layout->digitalInputCounterRegisters.value(circuit), ModbusRegisterTable::DigitalInputCounter, circuit, counterCodec);
+    }
+    foreach (int modbusAddress, m_layout->watchdogResetCoils) {
+        m_registerTable.insert(QModbusDataUnit::RegisterType::Coils, modbusAddress, ModbusRegisterTable::WatchdogReset, QString::number(modbusAddress));
+    }
+
+    // PWM duty cycles are reported in percent of the configured cycle length
+    if (m_pwmCycleLength > 0) {
+        ModbusValueCodec::Format dutyCycleFormat;
+        dutyCycleFormat.scale = 100.0 / m_pwmCycleLength;
+        ModbusValueCodec dutyCycleCodec(dutyCycleFormat, m_analogWordOrder);
+        foreach (const QString &circuit, m_layout->pwmDutyCycleRegisters.keys()) {
+            m_registerTable.insert(QModbusDataUnit::RegisterType::HoldingRegisters, m_layout->pwmDutyCycleRegisters.value(circuit), ModbusRegisterTable::PwmOutput, circuit, dutyCycleCodec);
+        }
     }
-    return true;
 }
 
-bool Neuron::getCoils(QList<int> registerList)
+void Neuron::buildReadPlans()
 {
-    if (registerList.isEmpty()) {
-        return true;
+    // In packed mode the digital I/O state of a whole group is read from its MixedBits
+    // registers, only circuits without a packed register are still read as coils.
+    QSet<QString> packedInputs;
+    QSet<QString> packedOutputs;
+    ModbusReadPlan inputHoldingRegisters(QModbusDataUnit::RegisterType::HoldingRegisters, m_readGapTolerance);
+    ModbusReadPlan outputHoldingRegisters(QModbusDataUnit::RegisterType::HoldingRegisters, m_readGapTolerance);
+    if (m_packedDigitalPolling) {
+        foreach (int modbusAddress, m_layout->packedDigitalInputBits.keys()) {
+            inputHoldingRegisters.addSpan(modbusAddress);
+            foreach (const QString &circuit, m_layout->packedDigitalInputBits.value(modbusAddress)) {
+                packedInputs.insert(circuit);
+            }
+        }
+        foreach (int modbusAddress, m_layout->packedDigitalOutputBits.keys()) {
+            outputHoldingRegisters.addSpan(modbusAddress);
+            foreach (const QString &circuit, m_layout->packedDigitalOutputBits.value(modbusAddress)) {
+                packedOutputs.insert(circuit);
+            }
+        }
     }
 
-    std::sort(registerList.begin(), registerList.end());
-    int previousReg = registerList.first(); //first register to read and starting point to get the following registers
-    int startAddress;
-
-    QHash<int, int> registerGroups;
-
-    foreach (int reg, registerList) {
-        //qDebug(dcUniPi()) << "Register" << reg << "previous Register" << previousReg;
-        if (reg == previousReg) { //first register
-            startAddress = reg;
-            registerGroups.insert(startAddress, 1);
-        } else if (reg == (previousReg + 1)) { //next register in block
-            previousReg = reg;
-            registerGroups.insert(startAddress, (registerGroups.value(startAddress) + 1)); //update block length
-        } else {    // new block
-            startAddress = reg;
-            previousReg = reg;
-            registerGroups.insert(startAddress, 1);
-        }
+    ModbusReadPlan inputCoils(QModbusDataUnit::RegisterType::Coils, m_readGapTolerance);
+    foreach (const QString &circuit, m_layout->digitalInputRegisters.keys()) {
+        if (!packedInputs.contains(circuit))
+            inputCoils.addSpan(m_layout->digitalInputRegisters.value(circuit));
     }
 
-    foreach (int startAddress, registerGroups.keys()) {
-        QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::Coils, startAddress, registerGroups.value(startAddress));
-        if (m_readRequestQueue.isEmpty()) {
-            modbusReadRequest(request);
-        } else if (m_readRequestQueue.length() > 100) {
-            qCWarning(dcUniPi()) << "Neuron extension: too many pending read requests";
-        } else {
-            m_readRequestQueue.append(request);
-        }
+    ModbusReadPlan inputRegisters(QModbusDataUnit::RegisterType::InputRegisters, m_readGapTolerance);
+    foreach (const QString &circuit, m_layout->analogInputRegisters.keys()) {
+        inputRegisters.addSpan(m_layout->analogInputRegisters.value(circuit), ModbusValueCodec::wordCount(m_layout->analogFormats.value(circuit).dataType));
     }
-    return true;
+
+    m_inputPollPlan = inputCoils.requests() + inputHoldingRegisters.requests() + inputRegisters.requests();
+
+    ModbusReadPlan outputCoils(QModbusDataUnit::RegisterType::Coils, m_readGapTolerance);
+    foreach (const QString &circuit, m_layout->digitalOutputRegisters.keys()) {
+        if (!packedOutputs.contains(circuit))
+            outputCoils.addSpan(m_layout->digitalOutputRegisters.value(circuit));
+    }
+    if (m_watchdogTimeout > 0) {
+        outputCoils.addAddresses(m_layout->watchdogResetCoils);
+    }
+    outputHoldingRegisters.addAddresses(m_layout->pwmDutyCycleRegisters.values());
+    foreach (const QString &circuit, m_layout->analogOutputRegisters.keys()) {
+        outputHoldingRegisters.addSpan(m_layout->analogOutputRegisters.value(circuit), ModbusValueCodec::wordCount(m_layout->analogFormats.value(circuit).dataType));
+    }
+
+    m_outputPollPlan = outputCoils.requests() + outputHoldingRegisters.requests();
+
+    // The counter block is read in as few requests as possible at its own rate
+    ModbusReadPlan counterRegisters(QModbusDataUnit::RegisterType::HoldingRegisters, m_readGapTolerance);
+    counterRegisters.addAddresses(m_layout->digitalInputCounterRegisters.values(), 2);
+    m_counterPollPlan = counterRegisters.requests();
+
+    // Size the value image from what is polled, writes outside of it grow it
+    foreach (const QModbusDataUnit &request, m_inputPollPlan + m_outputPollPlan + m_counterPollPlan) {
+        m_valueImage.reserve(request.registerType(), request.startAddress(), static_cast<int>(request.valueCount()));
+    }
+
+    qCDebug(dcUniPi()) << "Neuron" << type() << "input poll requests:" << m_inputPollPlan.count() << "output poll requests:" << m_outputPollPlan.count();
 }
 
+void Neuron::queueChange(ModbusRegisterTable::CircuitType type, const QString &circuit, double value)
+{
+    IoChange change;
+    change.type = type;
+    change.circuit = circuit;
+    change.value = value;
+    m_changeSet.changes.append(change);
+}
 
-bool Neuron::getAllDigitalInputs()
+void Neuron::publishChanges()
 {
-    if (!m_modbusInterface) {
-        qCWarning(dcUniPi()) << "Neuron modbus interface not initialized";
-        return false;
-    }
-    return getCoils(m_modbusDigitalInputRegisters.values());
+    // During a resync the changes are collected and published as one snapshot
+    if (m_changeSet.changes.isEmpty() || m_resyncPending > 0)
+        return;
+
+    m_changeSet.timestamp = QDateTime::currentMSecsSinceEpoch();
+    emit ioChanged(m_changeSet);
+    m_changeSet.changes.clear();
 }
 
-bool Neuron::getAllDigitalOutputs()
+void Neuron::startResync()
 {
-    if (!m_modbusInterface) {
-        qCWarning(dcUniPi()) << "Neuron modbus interface not initialized";
-        return false;
+    // Anything may have changed while offline, forget the cached values and
+    // read every polled block once before the regular poll timers take over.
+    // The device may have been restarted, its configuration is checked again.
+    // Only the replies of these reads count, other reads may finish in between.
+    m_valueImage.invalidate();
+    m_resyncId++;
+    m_resyncRequestQueue = m_configRegisters.readRequests() + m_inputPollPlan + m_outputPollPlan + m_counterPollPlan;
+    m_resyncPending = m_resyncRequestQueue.count();
+    if (m_resyncPending == 0) {
+        finishResync();
+        return;
     }
-    return getCoils(m_modbusDigitalOutputRegisters.values());
+    qCDebug(dcUniPi()) << "Neuron" << type() << "resync," << m_resyncPending << "read requests";
+    sendNextRequests();
 }
 
-bool Neuron::getAllAnalogInputs()
+void Neuron::finishResync()
 {
-    if (!m_modbusInterface) {
-        qCWarning(dcUniPi()) << "Neuron modbus interface not initialized";
-        return false;
+    m_resyncPending = 0;
+    publishChanges();
+
+    if (m_inputPollingTimer)
+        m_inputPollingTimer->start();
+    if (m_outputPollingTimer)
+        m_outputPollingTimer->start();
+    if (m_counterPollingTimer && m_counterPollingInterval > 0)
+        m_counterPollingTimer->start();
+}
+
+void Neuron::decodePackedRegister(int modbusAddress, uint16_t value, uint16_t changedBits)
+{
+    if (m_layout->packedDigitalInputBits.contains(modbusAddress)) {
+        const QHash<int, QString> &bits = m_layout->packedDigitalInputBits[modbusAddress];
+        for (QHash<int, QString>::const_iterator it = bits.constBegin(); it != bits.constEnd(); ++it) {
+            if (changedBits & (1 << it.key()))
+                queueChange(ModbusRegisterTable::DigitalInput, it.value(), value & (1 << it.key()));
+        }
     }
-    foreach(QString circuit, m_modbusAnalogInputRegisters.keys()) {
-        getAnalogInput(circuit);
+    if (m_layout->packedDigitalOutputBits.contains(modbusAddress)) {
+        const QHash<int, QString> &bits = m_layout->packedDigitalOutputBits[modbusAddress];
+        for (QHash<int, QString>::const_iterator it = bits.constBegin(); it != bits.constEnd(); ++it) {
+            if (changedBits & (1 << it.key()))
+                queueChange(ModbusRegisterTable::DigitalOutput, it.value(), value & (1 << it.key()));
+        }
     }
-    return true;
 }
 
-bool Neuron::getAllAnalogOutputs()
+bool Neuron::sendReadRequests(const QList<QModbusDataUnit> &requests)
 {
     if (!m_modbusInterface) {
         qCWarning(dcUniPi()) << "Neuron modbus interface not initialized";
         return false;
     }
-    foreach(QString circuit, m_modbusAnalogOutputRegisters.keys()) {
-        getAnalogOutput(circuit);
+
+    if (m_readRequestQueue.length() + requests.length() > 100) {
+        qCWarning(dcUniPi()) << "Neuron: too many pending read requests";
+        return false;
     }
+    m_readRequestQueue.append(requests);
+    sendNextRequests();
     return true;
 }
 
+void Neuron::sendNextRequests()
+{
+    // Keep the transaction window of the TCP client filled, the client matches
+    // the responses by their transaction id. Writes are served before polls.
+    while (!m_transactionWindow->isFull()) {
+        if (!m_writeRequestQueue.isEmpty()) {
+            Request request = m_writeRequestQueue.takeFirst();
+            if (!modbusWriteRequest(request)) {
+                QTimer::singleShot(0, this, [this, request] { finishWriteRequest(request, false); });
+            }
+        } else if (!m_resyncRequestQueue.isEmpty()) {
+            if (!modbusReadRequest(m_resyncRequestQueue.takeFirst(), true) && m_resyncPending > 0 && --m_resyncPending == 0)
+                finishResync();
+        } else if (!m_readRequestQueue.isEmpty()) {
+            modbusReadRequest(m_readRequestQueue.takeFirst());
+        } else {
+            break;
+        }
+    }
+}
+
 bool Neuron::getDigitalInput(const QString &circuit)
 {
-    int modbusAddress = m_modbusDigitalInputRegisters.value(circuit);
+    int modbusAddress = m_layout->digitalInputRegisters.value(circuit);
     //qDebug(dcUniPi()) << "Reading digital Input" << circuit << modbusAddress;
 
     if (!m_modbusInterface)
@@ -687,28 +916,21 @@ bool Neuron::getDigitalInput(const QString &circuit)
 
 bool Neuron::getAnalogOutput(const QString &circuit)
 {
-    int modbusAddress = m_modbusAnalogInputRegisters.value(circuit);
-    qDebug(dcUniPi()) << "Reading analog Input" << circuit << modbusAddress;
+    int modbusAddress = m_layout->analogOutputRegisters.value(circuit);
+    qDebug(dcUniPi()) << "Reading analog Output" << circuit << modbusAddress;
 
     if (!m_modbusInterface)
         return false;
 
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress, 2);
-    if (m_readRequestQueue.isEmpty()) {
-        //return modbusReadRequest(request);
-    } else if (m_readRequestQueue.length() > 100) {
-        qCWarning(dcUniPi()) << "Neuron extension: too many pending read requests";
-        return false;
-    } else {
-        //m_readRequestQueue.append(request); //FIXME
-    }
-    return true;
+    int wordCount = ModbusValueCodec::wordCount(m_layout->analogFormats.value(circuit).dataType);
+    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress, wordCount);
+    return sendReadRequests(QList<QModbusDataUnit>() << request);
 }
 
 
 QUuid Neuron::setDigitalOutput(const QString &circuit, bool value)
 {
-    int modbusAddress = m_modbusDigitalOutputRegisters.value(circuit);
+    int modbusAddress = m_layout->digitalOutputRegisters.value(circuit);
     //qDebug(dcUniPi()) << "Setting digital ouput" << circuit << modbusAddress << value;
 
     Request request;
@@ -716,59 +938,122 @@ QUuid Neuron::setDigitalOutput(const QString &circuit, bool value)
     request.data.setValue(0, static_cast<uint16_t>(value));
     request.id = QUuid::createUuid();
 
-    if (m_writeRequestQueue.isEmpty()) {
-        modbusWriteRequest(request);
-    } else if (m_writeRequestQueue.length() > 100) {
+    if (!enqueueWriteRequest(request)) {
         return "";
-    } else {
-        m_writeRequestQueue.append(request);
     }
+    sendNextRequests();
     return request.id;
 }
 
+QUuid Neuron::setDigitalOutputs(const QHash<QString, bool> &values)
+{
+    if (!m_modbusInterface)
+        return "";
+
+    QMap<int, bool> coilValues;
+    foreach (const QString &circuit, values.keys()) {
+        if (!m_layout->digitalOutputRegisters.contains(circuit)) {
+            qCWarning(dcUniPi()) << "Unknown digital output" << circuit;
+            return "";
+        }
+        coilValues.insert(m_layout->digitalOutputRegisters.value(circuit), values.value(circuit));
+    }
+
+    // A packed register is only written when every output in it is given. Bits
+    // taken from the polled image may be outdated and would revert other outputs.
+    QList<Request> requests;
+    if (m_packedDigitalPolling) {
+        foreach (int registerAddress, m_layout->packedDigitalOutputBits.keys()) {
+            const QHash<int, QString> bits = m_layout->packedDigitalOutputBits.value(registerAddress);
+            uint16_t value = 0;
+            bool complete = true;
+            for (QHash<int, QString>::const_iterator it = bits.constBegin(); it != bits.constEnd(); ++it) {
+                if (!values.contains(it.value())) {
+                    complete = false;
+                    break;
+                }
+                if (values.value(it.value()))
+                    value |= (1 << it.key());
+            }
+            if (!complete)
+                continue;
+
+            foreach (const QString &circuit, bits)
+                coilValues.remove(m_layout->digitalOutputRegisters.value(circuit));
+
+            Request request;
+            request.id = QUuid::createUuid();
+            request.data = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, registerAddress, 1);
+            request.data.setValue(0, value);
+            requests.append(request);
+        }
+    }
+
+    // Contiguous coils go out as one Write Multiple Coils request
+    QList<int> addresses = coilValues.keys();
+    int index = 0;
+    while (index < addresses.count()) {
+        int startAddress = addresses.at(index);
+        int count = 1;
+        while (index + count < addresses.count() && addresses.at(index + count) == startAddress + count)
+            count++;
+
+        Request request;
+        request.id = QUuid::createUuid();
+        request.data = QModbusDataUnit(QModbusDataUnit::RegisterType::Coils, startAddress, count);
+        for (int i = 0; i < count; i++)
+            request.data.setValue(i, static_cast<uint16_t>(coilValues.value(startAddress + i)));
+        requests.append(request);
+        index += count;
+    }
+
+    if (requests.isEmpty() || m_writeRequestQueue.length() + requests.length() > 100)
+        return "";
+
+    QUuid groupId = QUuid::createUuid();
+    m_requestGroupPending.insert(groupId, requests.count());
+    foreach (const Request &request, requests) {
+        m_requestGroups.insert(request.id, groupId);
+        enqueueWriteRequest(request);
+    }
+    sendNextRequests();
+    return groupId;
+}
+
 
 bool Neuron::getDigitalOutput(const QString &circuit)
 {
-    int modbusAddress = m_modbusDigitalOutputRegisters.value(circuit);
+    int modbusAddress = m_layout->digitalOutputRegisters.value(circuit);
     //qDebug(dcUniPi()) << "Reading digital Output" << circuit << modbusAddress;
 
     if (!m_modbusInterface)
         return false;
 
     QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress, 1);
-    if (m_readRequestQueue.isEmpty()) {
-        return modbusReadRequest(request);
-    } else if (m_readRequestQueue.length() > 100) {
-        qCWarning(dcUniPi()) << "Neuron extension: too many pending read requests";
-        return false;
-    } else {
-        m_readRequestQueue.append(request);
-    }
-    return true;
+    return sendReadRequests(QList<QModbusDataUnit>() << request);
 }
 
 
 QUuid Neuron::setAnalogOutput(const QString &circuit, double value)
 {
-    int modbusAddress = m_modbusAnalogOutputRegisters.value(circuit);
+    int modbusAddress = m_layout->analogOutputRegisters.value(circuit);
     qDebug(dcUniPi()) << "Writing analog Output" << circuit << modbusAddress;
 
     if (!m_modbusInterface)
         return "";
 
+    const ModbusRegisterTable::Circuit &outputCircuit = m_registerTable.circuit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress);
+    if (outputCircuit.type != ModbusRegisterTable::AnalogOutput)
+        return "";
+
     Request request;
     request.id = QUuid::createUuid();
-    request.data = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress, 2);
-    request.data.setValue(0, (static_cast<uint32_t>(value) >> 16));    //FIXME
-    request.data.setValue(0, (static_cast<uint32_t>(value) & 0xffff)); //FIXME
+    request.data = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress, outputCircuit.codec.encode(value));
 
-    if (m_writeRequestQueue.isEmpty()) {
-        modbusWriteRequest(request);
-    } else if (m_writeRequestQueue.length() > 100) {
+    if (!enqueueWriteRequest(request)) {
         return "";
-    } else {
-        m_writeRequestQueue.append(request);
     }
+    sendNextRequests();
 
     return request.id;
 }
@@ -776,27 +1061,95 @@ QUuid Neuron::setAnalogOutput(const QString &circuit, double value)
 
 bool Neuron::getAnalogInput(const QString &circuit)
 {
-    int modbusAddress = m_modbusAnalogInputRegisters.value(circuit);
+    int modbusAddress = m_layout->analogInputRegisters.value(circuit);
     qDebug(dcUniPi()) << "Reading analog Input" << circuit << modbusAddress;
 
     if (!m_modbusInterface)
         return false;
 
-    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::InputRegisters, modbusAddress, 2);
-    if (m_readRequestQueue.isEmpty()) {
-        return modbusReadRequest(request);
-    } else if (m_readRequestQueue.length() > 100) {
-        qCWarning(dcUniPi()) << "Neuron extension: too many pending read requests";
+    int wordCount = ModbusValueCodec::wordCount(m_layout->analogFormats.value(circuit).dataType);
+    QModbusDataUnit request = QModbusDataUnit(QModbusDataUnit::RegisterType::InputRegisters, modbusAddress, wordCount);
+    return sendReadRequests(QList<QModbusDataUnit>() << request);
+}
+
+bool Neuron::setDigitalInputDebounceTime(const QString &circuit, double milliseconds)
+{
+    if (!m_layout->digitalInputDebounceRegisters.contains(circuit))
         return false;
-    } else {
-        m_readRequestQueue.append(request);
+
+    // The register counts in 100 us steps, 0 leaves the device setting alone
+    int modbusAddress = m_layout->digitalInputDebounceRegisters.value(circuit);
+    if (milliseconds <= 0) {
+        m_configRegisters.unset(modbusAddress);
+        return true;
     }
+    m_configRegisters.set(modbusAddress, static_cast<quint16>(qBound(1, qRound(milliseconds * 10), 65535)));
+    if (m_modbusInterface && m_modbusInterface->state() == QModbusDevice::State::ConnectedState)
+        sendReadRequests(QList<QModbusDataUnit>() << m_configRegisters.readRequest(modbusAddress));
     return true;
 }
 
+bool Neuron::setDigitalInputDirectSwitch(const QString &circuit, bool enabled, bool toggle, bool inverted)
+{
+    // DirectSwitch lets the MCU drive the output of the same circuit from the input
+    if (!m_layout->directSwitchEnableBits.contains(circuit))
+        return false;
+
+    setConfigBit(m_layout->directSwitchEnableBits.value(circuit), enabled);
+    if (m_layout->directSwitchToggleBits.contains(circuit))
+        setConfigBit(m_layout->directSwitchToggleBits.value(circuit), enabled && toggle);
+    if (m_layout->directSwitchInvertBits.contains(circuit))
+        setConfigBit(m_layout->directSwitchInvertBits.value(circuit), enabled && inverted);
+    return true;
+}
+
+bool Neuron::resetDigitalInputDirectSwitch(const QString &circuit)
+{
+    if (!m_layout->directSwitchEnableBits.contains(circuit))
+        return false;
+
+    QList<QPair<int, int> > configBits;
+    configBits << m_layout->directSwitchEnableBits.value(circuit);
+    if (m_layout->directSwitchToggleBits.contains(circuit))
+        configBits << m_layout->directSwitchToggleBits.value(circuit);
+    if (m_layout->directSwitchInvertBits.contains(circuit))
+        configBits << m_layout->directSwitchInvertBits.value(circuit);
+    foreach (const QPair<int, int> &configBit, configBits) {
+        m_configRegisters.unset(configBit.first, 1 << configBit.second);
+    }
+    return true;
+}
+
+void Neuron::setConfigBit(const QPair<int, int> &configBit, bool value)
+{
+    quint16 mask = 1 << configBit.second;
+    m_configRegisters.set(configBit.first, value ? mask : 0, mask);
+    if (m_modbusInterface && m_modbusInterface->state() == QModbusDevice::State::ConnectedState)
+        sendReadRequests(QList<QModbusDataUnit>() << m_configRegisters.readRequest(configBit.first));
+}
+
+QUuid Neuron::setPwmDutyCycle(const QString &circuit, double dutyCycle)
+{
+    int modbusAddress = m_layout->pwmDutyCycleRegisters.value(circuit, -1);
+    const ModbusRegisterTable::Circuit &outputCircuit = m_registerTable.circuit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress);
+    if (!m_modbusInterface || outputCircuit.type != ModbusRegisterTable::PwmOutput)
+        return "";
+
+    Request request;
+    request.id = QUuid::createUuid();
+    request.data = QModbusDataUnit(QModbusDataUnit::RegisterType::HoldingRegisters, modbusAddress, outputCircuit.codec.encode(qBound(0.0, dutyCycle, 100.0)));
+
+    if (!enqueueWriteRequest(request)) {
+        return "";
+    }
+    sendNextRequests();
+
+    return request.id;
+}
+
 QUuid Neuron::setUserLED(const QString &circuit, bool value)
 {
-    int modbusAddress = m_modbusUserLEDRegisters.value(circuit);
+    int modbusAddress = m_layout->userLEDRegisters.value(circuit);
     //qDebug(dcUniPi()) << "Setting digital ouput" << circuit << modbusAddress << value;
 
     if (!m_modbusInterface)
@@ -808,13 +1161,10 @@ QUuid Neuron::setUserLED(const QString &circuit, bool value)
     request.data = QModbusDataUnit(QModbusDataUnit::RegisterType::Coils, modbusAddress, 1);
     request.data.setValue(0, static_cast<uint16_t>(value));
 
-    if (m_writeRequestQueue.isEmpty()) {
-        modbusWriteRequest(request);
-    } else if (m_writeRequestQueue.length() > 100) {
+    if (!enqueueWriteRequest(request)) {
         return "";
-    } else {
-        m_writeRequestQueue.append(request);
     }
+    sendNextRequests();
 
     return request.id;
 }
@@ -822,7 +1172,7 @@ QUuid Neuron::setUserLED(const QString &circuit, bool value)
 
 bool Neuron::getUserLED(const QString &circuit)
 {
-    int modbusAddress = m_modbusUserLEDRegisters.value(circuit);
+    int modbusAddress = m_layout->userLEDRegisters.value(circuit);
     //qDebug(dcUniPi()) << "Reading digital Output" << circuit << modbusAddress;
 
     if (!m_modbusInterface)
@@ -843,12 +1193,15 @@ bool Neuron::getUserLED(const QString &circuit)
 
 void Neuron::onOutputPollingTimer()
 {
-    getAllDigitalOutputs();
-    getAllAnalogOutputs();
+    sendReadRequests(m_outputPollPlan);
+}
+
+void Neuron::onCounterPollingTimer()
+{
+    sendReadRequests(m_counterPollPlan);
 }
 
 void Neuron::onInputPollingTimer()
 {
-    getAllDigitalInputs();
-    getAllAnalogInputs();
+    sendReadRequests(m_inputPollPlan);
 }
@@ -37,6 +37,15 @@
 #include <QtSerialBus>
 #include <QUuid>
 
+#include "modbusregistertable.h"
+#include "modbusvalueimage.h"
+#include "iochangeset.h"
+#include "modbusconfigregisters.h"
+#include "modbustimeoutwheel.h"
+#include "modbusrttestimator.h"
+#include "modbustransactionwindow.h"
+#include "modbusmap.h"
+
 class Neuron : public QObject
 {
     Q_OBJECT
@@ -45,6 +54,7 @@ public:
     struct Request {
         QUuid id;
         QModbusDataUnit data;
+        QList<QUuid> supersededIds;
     };
 
     enum NeuronTypes {
@@ -64,7 +74,7 @@ public:
         L533
     };
 
-    explicit Neuron(NeuronTypes neuronType, QModbusTcpClient *modbusInterface, QObject *parent = nullptr);
+    explicit Neuron(NeuronTypes neuronType, QModbusTcpClient *modbusInterface, ModbusRttEstimator *rttEstimator, ModbusTimeoutWheel *timeoutWheel, ModbusTransactionWindow *transactionWindow, QObject *parent = nullptr);
     ~Neuron();
 
     bool init();
@@ -75,65 +85,101 @@ public:
     QList<QString> analogInputs();
     QList<QString> analogOutputs();
     QList<QString> userLEDs();
+    QList<QString> pwmOutputs();
 
     QUuid setDigitalOutput(const QString &circuit, bool value);
+    QUuid setDigitalOutputs(const QHash<QString, bool> &values);
     QUuid setAnalogOutput(const QString &circuit, double value);
     QUuid setUserLED(const QString &circuit, bool value);
+    QUuid setPwmDutyCycle(const QString &circuit, double dutyCycle);
 
     bool getDigitalOutput(const QString &circuit);
     bool getDigitalInput(const QString &circuit);
+    bool setDigitalInputDebounceTime(const QString &circuit, double milliseconds);
+    bool setDigitalInputDirectSwitch(const QString &circuit, bool enabled, bool toggle, bool inverted);
+    bool resetDigitalInputDirectSwitch(const QString &circuit);
 
     bool getAnalogOutput(const QString &circuit);
     bool getAnalogInput(const QString &circuit);
 
-    bool getAllDigitalOutputs();
-    bool getAllDigitalInputs();
-    bool getAllAnalogInputs();
-    bool getAllAnalogOutputs();
-
     bool getUserLED(const QString &circuit);
+
+    void setReadGapTolerance(int gapTolerance);
+    void setPackedDigitalPolling(bool enabled);
+    void setAnalogWordOrder(ModbusValueCodec::WordOrder wordOrder);
+    void setWatchdogTimeout(int milliseconds);
+    void setPwmFrequency(double frequency);
+    void setCounterPollingInterval(int interval);
+
 private:
     int m_slaveAddress = 0;
-    uint m_responseTimeoutTime = 2000;
+    ModbusRttEstimator *m_rttEstimator = nullptr;   // shared by all Neurons on the TCP client
+    int m_readGapTolerance = 0;
+    bool m_packedDigitalPolling = false;
+    ModbusTransactionWindow *m_transactionWindow = nullptr; // shared by all Neurons on the TCP client
+    ModbusValueCodec::WordOrder m_analogWordOrder = ModbusValueCodec::HighWordFirst;
+    int m_resyncPending = 0;    // reads of the resync burst still outstanding
+    int m_resyncId = 0;         // replies of an aborted resync don't count for the next one
 
     QTimer *m_inputPollingTimer = nullptr;
     QTimer *m_outputPollingTimer = nullptr;
+    QTimer *m_counterPollingTimer = nullptr;
+    int m_counterPollingInterval = 1000;
+    ModbusTimeoutWheel *m_timeoutWheel = nullptr;  // shared by all Neurons on the TCP client
 
     QModbusTcpClient *m_modbusInterface = nullptr;
 
-    QHash<QString, int> m_modbusDigitalOutputRegisters;
-    QHash<QString, int> m_modbusDigitalInputRegisters;
-    QHash<QString, int> m_modbusAnalogInputRegisters;
-    QHash<QString, int> m_modbusAnalogOutputRegisters;
-    QHash<QString, int> m_modbusUserLEDRegisters;
+    QSharedPointer<const ModbusMapLayout> m_layout = ModbusMap::emptyLayout();
+    ModbusConfigRegisters m_configRegisters;
+    int m_watchdogTimeout = 0;
+    int m_pwmCycleLength = 0;   // duty cycle register value of 100 %, 0 while not configured
+    ModbusRegisterTable m_registerTable;
     QList<Request> m_writeRequestQueue;
+    QHash<QUuid, QUuid> m_requestGroups;        // request id, id of the multi-output write it belongs to
+    QHash<QUuid, bool> m_requestGroupResults;
+    QHash<QUuid, int> m_requestGroupPending;    // group id, transactions still outstanding
     QList<QModbusDataUnit> m_readRequestQueue;
+    QList<QModbusDataUnit> m_resyncRequestQueue;   // served before the regular reads
+    QList<QModbusDataUnit> m_inputPollPlan;
+    QList<QModbusDataUnit> m_outputPollPlan;
+    QList<QModbusDataUnit> m_counterPollPlan;
 
     NeuronTypes m_neuronType = NeuronTypes::S103;
 
-    QHash<int, uint16_t> m_previousModbusRegisterValue;
+    ModbusValueImage m_valueImage;
+    QVector<quint16> m_changedBits;
+    IoChangeSet m_changeSet;
 
     bool loadModbusMap();
-    bool modbusReadRequest(const QModbusDataUnit &request);
+    bool modbusReadRequest(const QModbusDataUnit &request, bool resync = false);
     bool modbusWriteRequest(const Request &request);
-
-    bool getInputRegisters(QList<int> registers);
-    bool getHoldingRegisters(QList<int> registers);
-    bool getCoils(QList<int> registers);
+    void applyResponseTimeout();
+    void trackResponseTime(QModbusReply *reply);
+    bool enqueueWriteRequest(Request request);
+    void finishWriteRequest(const Request &request, bool success);
+    void completeRequest(const QUuid &requestId, bool success);
+
+    void buildRegisterTable();
+    void buildReadPlans();
+    void decodePackedRegister(int modbusAddress, uint16_t value, uint16_t changedBits);
+    void queueChange(ModbusRegisterTable::CircuitType type, const QString &circuit, double value);
+    void publishChanges();
+    void startResync();
+    void finishResync();
+    void setConfigBit(const QPair<int, int> &configBit, bool value);
+    bool sendReadRequests(const QList<QModbusDataUnit> &requests);
+    void sendNextRequests();
 
 signals:
     void requestExecuted(const QUuid &requestId, bool success);
     void requestError(const QUuid &requestId, const QString &error);
-    void digitalInputStatusChanged(const QString &circuit, bool value);
-    void digitalOutputStatusChanged(const QString &circuit, bool value);
-    void analogInputStatusChanged(const QString &circuit, double value);
-    void analogOutputStatusChanged(const QString &circuit, double value);
-    void userLEDStatusChanged(const QString &circuit, bool value);
+    void ioChanged(const IoChangeSet &changeSet);
     void connectionStateChanged(bool state);
 
 public slots:
     void onOutputPollingTimer();
     void onInputPollingTimer();
+    void onCounterPollingTimer();
 };
 
 #endif // NEURON_H
@@ -36,6 +36,16 @@
 #include <QTimer>
 #include <QtSerialBus>
 #include <QUuid>
+#include <QPointer>
+
+#include "modbusregistertable.h"
+#include "modbusvalueimage.h"
+#include "iochangeset.h"
+#include "modbusconfigregisters.h"
+#include "modbusrttestimator.h"
+#include "modbusmap.h"
+
+class NeuronExtensionBus;
 
 class NeuronExtension : public QObject
 {
@@ -45,6 +55,7 @@ public:
     struct Request {
         QUuid id;
         QModbusDataUnit data;
+        QList<QUuid> supersededIds;
     };
 
     enum ExtensionTypes {
@@ -57,7 +68,7 @@ public:
         xS51
     };
 
-    explicit NeuronExtension(ExtensionTypes extensionType, QModbusRtuSerialMaster *modbusInterface, int slaveAddress, QObject *parent = nullptr);
+    explicit NeuronExtension(ExtensionTypes extensionType, NeuronExtensionBus *bus, int slaveAddress, QObject *parent = nullptr);
     ~NeuronExtension();
 
     bool init();
@@ -72,59 +83,92 @@ public:
     QList<QString> userLEDs();
 
     QUuid setDigitalOutput(const QString &circuit, bool value);
+    QUuid setDigitalOutputs(const QHash<QString, bool> &values);
     bool getDigitalOutput(const QString &circuit);
     bool getDigitalInput(const QString &circuit);
+    bool setDigitalInputDebounceTime(const QString &circuit, double milliseconds);
+    bool setDigitalInputDirectSwitch(const QString &circuit, bool enabled, bool toggle, bool inverted);
+    bool resetDigitalInputDirectSwitch(const QString &circuit);
 
     QUuid setAnalogOutput(const QString &circuit, double value);
     bool getAnalogOutput(const QString &circuit);
     bool getAnalogInput(const QString &circuit);
 
-    bool getAllDigitalOutputs();
-    bool getAllDigitalInputs();
-    bool getAllAnalogOutputs();
-    bool getAllAnalogInputs();
-
     QUuid setUserLED(const QString &circuit, bool value);
     bool getUserLED(const QString &circuit);
-private:
-    uint m_responseTimeoutTime = 2000;
 
-    QTimer *m_inputPollingTimer = nullptr;
-    QTimer *m_outputPollingTimer = nullptr;
+    void setReadGapTolerance(int gapTolerance);
+    void setPackedDigitalPolling(bool enabled);
+    void setAnalogWordOrder(ModbusValueCodec::WordOrder wordOrder);
+    void setWatchdogTimeout(int milliseconds);
+
+    QList<QModbusDataUnit> inputPollPlan() const;
+    QList<QModbusDataUnit> outputPollPlan() const;
+    QList<QModbusDataUnit> counterPollPlan() const;
+    bool pollInputs();
+    bool pollOutputs();
+    bool pollCounters();
+
+    bool hasPendingRequests() const;
+    QModbusReply *sendNextRequest();
+    int transactionTimeout() const;
 
-    QHash<QString, int> m_modbusDigitalOutputRegisters;
-    QHash<QString, int> m_modbusDigitalInputRegisters;
-    QHash<QString, int> m_modbusAnalogInputRegisters;
-    QHash<QString, int> m_modbusAnalogOutputRegisters;
-    QHash<QString, int> m_modbusUserLEDRegisters;
+private:
+    int m_readGapTolerance = 0;
+    bool m_packedDigitalPolling = false;
+    ModbusValueCodec::WordOrder m_analogWordOrder = ModbusValueCodec::HighWordFirst;
+
+    QSharedPointer<const ModbusMapLayout> m_layout = ModbusMap::emptyLayout();
+    ModbusConfigRegisters m_configRegisters;
+    int m_watchdogTimeout = 0;
+    ModbusRegisterTable m_registerTable;
     QList<Request> m_writeRequestQueue;
+    QHash<QUuid, QUuid> m_requestGroups;        // request id, id of the multi-output write it belongs to
+    QHash<QUuid, bool> m_requestGroupResults;
+    QHash<QUuid, int> m_requestGroupPending;    // group id, transactions still outstanding
     QList<QModbusDataUnit> m_readRequestQueue;
-
+    QList<QModbusDataUnit> m_resyncRequestQueue;   // served before the regular reads
+    QList<QModbusDataUnit> m_inputPollPlan;
+    QList<QModbusDataUnit> m_outputPollPlan;
+    QList<QModbusDataUnit> m_counterPollPlan;
+
+    QPointer<NeuronExtensionBus> m_bus;
+    ModbusRttEstimator m_rttEstimator = ModbusRttEstimator(100, 10, 1000);
+    double m_lineTime = 0;      // time on the wire of the current transaction
+    int m_resyncPending = 0;    // reads of the resync burst still outstanding
+    int m_resyncId = 0;         // replies of an aborted resync don't count for the next one
     QModbusRtuSerialMaster *m_modbusInterface = nullptr;
     int m_slaveAddress = 0;
     ExtensionTypes m_extensionType = ExtensionTypes::xS10;
-    QHash<int, uint16_t> m_previousModbusRegisterValue;
+    ModbusValueImage m_valueImage;
+    QVector<quint16> m_changedBits;
+    IoChangeSet m_changeSet;
 
     bool loadModbusMap();
-    bool modbusWriteRequest(const Request &request);
-    bool modbusReadRequest(const QModbusDataUnit &request);
+    void buildRegisterTable();
+    void buildReadPlans();
+    void decodePackedRegister(int modbusAddress, uint16_t value, uint16_t changedBits);
+    void queueChange(ModbusRegisterTable::CircuitType type, const QString &circuit, double value);
+    void publishChanges();
+    void startResync();
+    void finishResync();
+    void setConfigBit(const QPair<int, int> &configBit, bool value);
+    QModbusReply *modbusWriteRequest(const Request &request);
+    bool enqueueWriteRequest(Request request);
+    void applyResponseTimeout(const QModbusDataUnit &request, bool write);
+    void trackResponseTime(QModbusReply *reply);
+    void finishWriteRequest(const Request &request, bool success);
+    void completeRequest(const QUuid &requestId, bool success);
+    QModbusReply *modbusReadRequest(const QModbusDataUnit &request);
+    bool sendReadRequests(const QList<QModbusDataUnit> &requests);
+    bool queuePollPlan(const QList<QModbusDataUnit> &plan);
 
 signals:
     void requestExecuted(const QUuid &requestId, bool success);
     void requestError(const QUuid &requestId, const QString &error);
-    void digitalInputStatusChanged(const QString &circuit, bool value);
-    void digitalOutputStatusChanged(const QString &circuit, bool value);
-
-    void analogInputStatusChanged(const QString &circuit, double value);
-    void analogOutputStatusChanged(const QString &circuit, double value);
-
-    void userLEDStatusChanged(const QString &circuit, bool value);
+    void ioChanged(const IoChangeSet &changeSet);
 
     void connectionStateChanged(bool state);
-
-private slots:
-    void onOutputPollingTimer();
-    void onInputPollingTimer();
 };
 
 #endif // NEURONEXTENSION_H
@@ -0,0 +1,277 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "neuronextensionbus.h"
+#include "neuronextension.h"
+#include "extern-plugininfo.h"
+
+#include <QSerialPort>
+
+NeuronExtensionBus::NeuronExtensionBus(QModbusRtuSerialMaster *modbusInterface, QObject *parent) :
+    QObject(parent),
+    m_modbusInterface(modbusInterface)
+{
+    m_modbusInterface->setParent(this);
+
+    m_inputPollingTimer = new QTimer(this);
+    connect(m_inputPollingTimer, &QTimer::timeout, this, &NeuronExtensionBus::onInputPollingTimer);
+    m_inputPollingTimer->setTimerType(Qt::TimerType::PreciseTimer);
+    m_inputPollingTimer->setInterval(200);
+
+    m_outputPollingTimer = new QTimer(this);
+    connect(m_outputPollingTimer, &QTimer::timeout, this, &NeuronExtensionBus::onOutputPollingTimer);
+    m_outputPollingTimer->setTimerType(Qt::TimerType::PreciseTimer);
+    m_outputPollingTimer->setInterval(1000);
+
+    m_counterPollingTimer = new QTimer(this);
+    connect(m_counterPollingTimer, &QTimer::timeout, this, &NeuronExtensionBus::onCounterPollingTimer);
+    m_counterPollingTimer->setTimerType(Qt::TimerType::PreciseTimer);
+    m_counterPollingTimer->setInterval(m_counterPollingInterval);
+
+    m_timeoutWheel = new ModbusTimeoutWheel(50, this);
+
+    if (m_modbusInterface->state() == QModbusDevice::State::ConnectedState) {
+        m_inputPollingTimer->start();
+        m_outputPollingTimer->start();
+        m_counterPollingTimer->start();
+    }
+
+    connect(m_modbusInterface, &QModbusDevice::stateChanged, this, [this] (QModbusDevice::State state) {
+        if (state == QModbusDevice::State::ConnectedState) {
+            m_inputPollingTimer->start();
+            m_outputPollingTimer->start();
+            if (m_counterPollingInterval > 0)
+                m_counterPollingTimer->start();
+            sendNextRequest();
+        } else {
+            m_inputPollingTimer->stop();
+            m_outputPollingTimer->stop();
+            m_counterPollingTimer->stop();
+        }
+    });
+}
+
+QModbusRtuSerialMaster *NeuronExtensionBus::modbusInterface() const
+{
+    return m_modbusInterface;
+}
+
+void NeuronExtensionBus::addExtension(NeuronExtension *extension)
+{
+    if (m_extensions.contains(extension))
+        return;
+
+    m_extensions.append(extension);
+}
+
+void NeuronExtensionBus::removeExtension(NeuronExtension *extension)
+{
+    m_extensions.removeAll(extension);
+    if (m_nextExtension >= m_extensions.count())
+        m_nextExtension = 0;
+    updateBusLoad();
+}
+
+void NeuronExtensionBus::setInputPollingInterval(int interval)
+{
+    m_inputPollingTimer->setInterval(qMax(10, interval));
+    updateBusLoad();
+}
+
+void NeuronExtensionBus::setOutputPollingInterval(int interval)
+{
+    m_outputPollingTimer->setInterval(qMax(10, interval));
+    updateBusLoad();
+}
+
+void NeuronExtensionBus::setCounterPollingInterval(int interval)
+{
+    // 0 disables the counter polling
+    m_counterPollingInterval = (interval > 0) ? qMax(10, interval) : 0;
+    if (m_counterPollingInterval == 0) {
+        m_counterPollingTimer->stop();
+    } else {
+        m_counterPollingTimer->setInterval(m_counterPollingInterval);
+        if (m_modbusInterface->state() == QModbusDevice::State::ConnectedState)
+            m_counterPollingTimer->start();
+    }
+    updateBusLoad();
+}
+
+double NeuronExtensionBus::busLoad() const
+{
+    return m_busLoad;
+}
+
+void NeuronExtensionBus::sendNextRequest()
+{
+    // RTU is half duplex, only one transaction may be on the line. The slaves take
+    // turns so a busy extension can't starve the others.
+    if (m_busy || m_extensions.isEmpty() || m_modbusInterface->state() != QModbusDevice::ConnectedState)
+        return;
+
+    for (int i = 0; i < m_extensions.count(); i++) {
+        NeuronExtension *extension = m_extensions.at(m_nextExtension);
+        m_nextExtension = (m_nextExtension + 1) % m_extensions.count();
+
+        if (!extension->hasPendingRequests())
+            continue;
+
+        QModbusReply *reply = extension->sendNextRequest();
+        if (!reply)
+            continue;
+
+        m_busy = true;
+        m_timeoutWheel->track(reply, extension->transactionTimeout());
+        connect(reply, &QModbusReply::destroyed, this, [this] {
+            m_busy = false;
+            sendNextRequest();
+        });
+        return;
+    }
+}
+
+double NeuronExtensionBus::characterTime() const
+{
+    // Start bit, 8 data bits, optional parity bit and stop bits, in milliseconds
+    int baudrate = m_modbusInterface->connectionParameter(QModbusDevice::SerialBaudRateParameter).toInt();
+    if (baudrate <= 0)
+        baudrate = 19200;
+
+    double bits = 1 + 8;
+    switch (m_modbusInterface->connectionParameter(QModbusDevice::SerialStopBitsParameter).toInt()) {
+    case QSerialPort::OneAndHalfStop:
+        bits += 1.5;
+        break;
+    case QSerialPort::TwoStop:
+        bits += 2;
+        break;
+    default:
+        bits += 1;
+        break;
+    }
+    if (m_modbusInterface->connectionParameter(QModbusDevice::SerialParityParameter).toInt() != QSerialPort::NoParity)
+        bits += 1;
+
+    return bits * 1000.0 / baudrate;
+}
+
+double NeuronExtensionBus::transactionTime(const QModbusDataUnit &request, bool write) const
+{
+    int dataBytes = static_cast<int>(request.valueCount()) * 2;
+    if (request.registerType() == QModbusDataUnit::Coils || request.registerType() == QModbusDataUnit::DiscreteInputs)
+        dataBytes = (static_cast<int>(request.valueCount()) + 7) / 8;
+
+    // Slave address, function code, address, count and CRC. Reads answer with a
+    // byte count and the data, writes carry the data in the request.
+    int requestBytes = 8;
+    int responseBytes = 5 + dataBytes;
+    if (write) {
+        requestBytes = (request.valueCount() == 1) ? 8 : 9 + dataBytes;
+        responseBytes = 8;
+    }
+
+    // Each frame is followed by 3.5 characters of silence, fixed to 1.75 ms above 19200 baud
+    double charTime = characterTime();
+    double silence = 3.5 * charTime;
+    if (m_modbusInterface->connectionParameter(QModbusDevice::SerialBaudRateParameter).toInt() > 19200)
+        silence = 1.75;
+
+    // Allow one millisecond for the slave to turn the request around
+    return (requestBytes + responseBytes) * charTime + 2 * silence + 1.0;
+}
+
+void NeuronExtensionBus::updateBusLoad()
+{
+    double inputTime = 0;
+    double outputTime = 0;
+    double counterTime = 0;
+    foreach (NeuronExtension *extension, m_extensions) {
+        foreach (const QModbusDataUnit &request, extension->inputPollPlan()) {
+            inputTime += transactionTime(request, false);
+        }
+        foreach (const QModbusDataUnit &request, extension->outputPollPlan()) {
+            outputTime += transactionTime(request, false);
+        }
+        foreach (const QModbusDataUnit &request, extension->counterPollPlan()) {
+            counterTime += transactionTime(request, false);
+        }
+    }
+
+    m_busLoad = inputTime / m_inputPollingTimer->interval() + outputTime / m_outputPollingTimer->interval();
+    if (m_counterPollingInterval > 0)
+        m_busLoad += counterTime / m_counterPollingInterval;
+
+    bool overloaded = (m_busLoad > 1.0);
+    if (overloaded && !m_overloaded) {
+        qCWarning(dcUniPi()) << "RTU bus: configured poll rates can't be met, the polls need" << QString::number(m_busLoad * 100, 'f', 0) << "% of the bus time."
+                             << "Input poll cycle" << inputTime << "ms every" << m_inputPollingTimer->interval() << "ms,"
+                             << "output poll cycle" << outputTime << "ms every" << m_outputPollingTimer->interval() << "ms";
+    } else if (!overloaded && m_overloaded) {
+        qCDebug(dcUniPi()) << "RTU bus: poll rates fit the bus again, load" << QString::number(m_busLoad * 100, 'f', 0) << "%";
+    }
+    m_overloaded = overloaded;
+}
+
+void NeuronExtensionBus::onInputPollingTimer()
+{
+    foreach (NeuronExtension *extension, m_extensions) {
+        if (!extension->pollInputs()) {
+            m_pollOverruns++;
+            if (m_pollOverruns == 1 || m_pollOverruns % 100 == 0)
+                qCWarning(dcUniPi()) << "RTU bus: poll cycle of slave" << extension->slaveAddress() << "not finished in time, overruns:" << m_pollOverruns;
+        }
+    }
+}
+
+void NeuronExtensionBus::onCounterPollingTimer()
+{
+    foreach (NeuronExtension *extension, m_extensions) {
+        if (!extension->pollCounters()) {
+            m_pollOverruns++;
+            if (m_pollOverruns == 1 || m_pollOverruns % 100 == 0)
+                qCWarning(dcUniPi()) << "RTU bus: poll cycle of slave" << extension->slaveAddress() << "not finished in time, overruns:" << m_pollOverruns;
+        }
+    }
+}
+
+void NeuronExtensionBus::onOutputPollingTimer()
+{
+    // The read plans change with the plugin configuration, keep the budget current
+    updateBusLoad();
+
+    foreach (NeuronExtension *extension, m_extensions) {
+        if (!extension->pollOutputs()) {
+            m_pollOverruns++;
+            if (m_pollOverruns == 1 || m_pollOverruns % 100 == 0)
+                qCWarning(dcUniPi()) << "RTU bus: poll cycle of slave" << extension->slaveAddress() << "not finished in time, overruns:" << m_pollOverruns;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef NEURONEXTENSIONBUS_H
+#define NEURONEXTENSIONBUS_H
+
+#include <QObject>
+#include <QTimer>
+#include <QtSerialBus>
+
+#include "modbustimeoutwheel.h"
+
+class NeuronExtension;
+
+class NeuronExtensionBus : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NeuronExtensionBus(QModbusRtuSerialMaster *modbusInterface, QObject *parent = nullptr);
+
+    QModbusRtuSerialMaster *modbusInterface() const;
+
+    void addExtension(NeuronExtension *extension);
+    void removeExtension(NeuronExtension *extension);
+
+    void setInputPollingInterval(int interval);
+    void setOutputPollingInterval(int interval);
+    void setCounterPollingInterval(int interval);
+
+    double busLoad() const;
+    double transactionTime(const QModbusDataUnit &request, bool write) const;
+
+public slots:
+    void sendNextRequest();
+
+private:
+    QModbusRtuSerialMaster *m_modbusInterface = nullptr;
+    QList<NeuronExtension *> m_extensions;
+    int m_nextExtension = 0;
+    bool m_busy = false;
+    ModbusTimeoutWheel *m_timeoutWheel = nullptr;
+
+    QTimer *m_inputPollingTimer = nullptr;
+    QTimer *m_outputPollingTimer = nullptr;
+    QTimer *m_counterPollingTimer = nullptr;
+    int m_counterPollingInterval = 1000;
+
+    double m_busLoad = 0;
+    bool m_overloaded = false;
+    int m_pollOverruns = 0;
+
+    double characterTime() const;
+    void updateBusLoad();
+
+private slots:
+    void onInputPollingTimer();
+    void onOutputPollingTimer();
+    void onCounterPollingTimer();
+};
+
+#endif // NEURONEXTENSIONBUS_H
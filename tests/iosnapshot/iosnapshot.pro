@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+TARGET = tst_iosnapshot
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    tst_iosnapshot.cpp \
+    ../extern-plugininfo.cpp \
+    $$PLUGIN_DIR/iosnapshot.cpp
+
+HEADERS += \
+    ../extern-plugininfo.h \
+    $$PLUGIN_DIR/iosnapshot.h
@@ -0,0 +1,163 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "iosnapshot.h"
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+class TestIoSnapshot : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void setValue();
+    void roundTrip();
+    void removeDevice();
+    void missingFile();
+    void unknownFormat();
+    void truncatedFile();
+};
+
+void TestIoSnapshot::setValue()
+{
+    IoSnapshot snapshot;
+    QUuid deviceId = QUuid::createUuid();
+    double value = 0;
+    QVERIFY(!snapshot.isDirty());
+    QVERIFY(!snapshot.value(deviceId, 1, "1.1", &value));
+
+    snapshot.setValue(deviceId, 1, "1.1", 4.5);
+    QVERIFY(snapshot.isDirty());
+    bool stale = true;
+    QVERIFY(snapshot.value(deviceId, 1, "1.1", &value, &stale));
+    QCOMPARE(value, 4.5);
+    QVERIFY(!stale);
+
+    // The type is part of the key
+    QVERIFY(!snapshot.value(deviceId, 2, "1.1", &value));
+}
+
+void TestIoSnapshot::roundTrip()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString fileName = directory.filePath("snapshot");
+
+    QUuid first = QUuid::createUuid();
+    QUuid second = QUuid::createUuid();
+    IoSnapshot snapshot;
+    snapshot.setValue(first, 0, "1.1", 1);
+    snapshot.setValue(first, 3, "1.1", 7.25);
+    snapshot.setValue(second, 0, "2.4", 0);
+    QVERIFY(snapshot.save(fileName));
+    QVERIFY(!snapshot.isDirty());
+
+    IoSnapshot loaded;
+    QVERIFY(loaded.load(fileName));
+    QVERIFY(!loaded.isDirty());
+
+    double value = -1;
+    bool stale = false;
+    QVERIFY(loaded.value(first, 3, "1.1", &value, &stale));
+    QCOMPARE(value, 7.25);
+    QVERIFY(stale);
+    QVERIFY(loaded.value(first, 0, "1.1", &value));
+    QCOMPARE(value, 1.0);
+    QVERIFY(loaded.value(second, 0, "2.4", &value));
+    QCOMPARE(value, 0.0);
+
+    // A live value confirms a stale one even if it didn't change
+    loaded.setValue(first, 3, "1.1", 7.25);
+    QVERIFY(loaded.isDirty());
+    QVERIFY(loaded.value(first, 3, "1.1", &value, &stale));
+    QVERIFY(!stale);
+}
+
+void TestIoSnapshot::removeDevice()
+{
+    IoSnapshot snapshot;
+    QUuid deviceId = QUuid::createUuid();
+    snapshot.removeDevice(deviceId);
+    QVERIFY(!snapshot.isDirty());
+
+    snapshot.setValue(deviceId, 0, "1.1", 1);
+    QTemporaryDir directory;
+    QVERIFY(snapshot.save(directory.filePath("snapshot")));
+    snapshot.removeDevice(deviceId);
+    QVERIFY(snapshot.isDirty());
+    double value;
+    QVERIFY(!snapshot.value(deviceId, 0, "1.1", &value));
+}
+
+void TestIoSnapshot::missingFile()
+{
+    QTemporaryDir directory;
+    IoSnapshot snapshot;
+    QVERIFY(!snapshot.load(directory.filePath("missing")));
+}
+
+void TestIoSnapshot::unknownFormat()
+{
+    QTemporaryDir directory;
+    QFile file(directory.filePath("snapshot"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not a snapshot");
+    file.close();
+
+    IoSnapshot snapshot;
+    QVERIFY(!snapshot.load(file.fileName()));
+}
+
+void TestIoSnapshot::truncatedFile()
+{
+    QTemporaryDir directory;
+    QString fileName = directory.filePath("snapshot");
+    QUuid deviceId = QUuid::createUuid();
+    IoSnapshot snapshot;
+    snapshot.setValue(deviceId, 0, "1.1", 1);
+    snapshot.setValue(deviceId, 0, "1.2", 0);
+    QVERIFY(snapshot.save(fileName));
+
+    QFile file(fileName);
+    QVERIFY(file.resize(file.size() - 4));
+
+    // A truncated file leaves the loaded values untouched
+    IoSnapshot loaded;
+    loaded.setValue(deviceId, 0, "1.3", 1);
+    QVERIFY(!loaded.load(fileName));
+    double value;
+    QVERIFY(loaded.value(deviceId, 0, "1.3", &value));
+    QVERIFY(!loaded.value(deviceId, 0, "1.1", &value));
+}
+
+QTEST_GUILESS_MAIN(TestIoSnapshot)
+
+#include "tst_iosnapshot.moc"
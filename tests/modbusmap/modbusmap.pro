@@ -0,0 +1,16 @@
+include(../tests.pri)
+
+TARGET = tst_modbusmap
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    tst_modbusmap.cpp \
+    ../extern-plugininfo.cpp \
+    $$PLUGIN_DIR/modbusmap.cpp \
+    $$PLUGIN_DIR/modbusvaluecodec.cpp
+
+HEADERS += \
+    ../extern-plugininfo.h \
+    $$PLUGIN_DIR/modbusmap.h \
+    $$PLUGIN_DIR/modbusvaluecodec.h
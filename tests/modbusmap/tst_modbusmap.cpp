@@ -0,0 +1,161 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusmap.h"
+
+#include <QtTest>
+
+Q_DECLARE_METATYPE(ModbusMap::EntryType)
+
+class TestModbusMap : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void circuitName_data();
+    void circuitName();
+    void classify_data();
+    void classify();
+    void ignoredRows_data();
+    void ignoredRows();
+    void analogFormat();
+};
+
+void TestModbusMap::circuitName_data()
+{
+    QTest::addColumn<QString>("content");
+    QTest::addColumn<QString>("circuit");
+
+    QTest::newRow("digital input") << "Digital Input 1.1" << "1.1";
+    QTest::newRow("relay output") << "Relay Output 2.14" << "2.14";
+    QTest::newRow("range") << "Analog Output Value 1.1 (0..4000 ~ 0..10V)" << "1.1";
+    QTest::newRow("unit") << "Debounce time (in 100us) for DI 3.2" << "3.2";
+    QTest::newRow("no circuit") << "Group MasterWatchDog (MWD) Timeout (in 1ms)" << "Timeout";
+}
+
+void TestModbusMap::circuitName()
+{
+    QFETCH(QString, content);
+    QFETCH(QString, circuit);
+
+    QCOMPARE(ModbusMap::circuitName(content), circuit);
+}
+
+void TestModbusMap::classify_data()
+{
+    QTest::addColumn<QString>("row");
+    QTest::addColumn<bool>("coils");
+    QTest::addColumn<ModbusMap::EntryType>("type");
+    QTest::addColumn<int>("address");
+    QTest::addColumn<int>("bit");
+    QTest::addColumn<QString>("circuit");
+
+    QTest::newRow("digital input coil") << "0,0,R,Digital Input 1.1,Basic" << true << ModbusMap::DigitalInput << 0 << -1 << "1.1";
+    QTest::newRow("digital output coil") << "100,100,RW,Digital Output 1.4,Basic" << true << ModbusMap::DigitalOutput << 100 << -1 << "1.4";
+    QTest::newRow("relay output coil") << "101,101,RW,Relay Output 2.1,Basic" << true << ModbusMap::DigitalOutput << 101 << -1 << "2.1";
+    QTest::newRow("user led coil") << "8,8,RW,User Programmable LED 1.2,Basic" << true << ModbusMap::UserLED << 8 << -1 << "1.2";
+    QTest::newRow("watchdog reset coil") << "1002,1002,RW,MWD reset indication,Advanced" << true << ModbusMap::WatchdogResetCoil << 1002 << -1 << "1002";
+
+    QTest::newRow("packed digital input") << "0,0,1,R,MixedBits,Digital Input 1.3,2,Basic" << false << ModbusMap::PackedDigitalInput << 0 << 2 << "1.3";
+    QTest::newRow("packed relay output") << "1,1,1,RW,MixedBits,Relay Output 1.12,11,Basic" << false << ModbusMap::PackedDigitalOutput << 1 << 11 << "1.12";
+    QTest::newRow("directswitch enable") << "1023,1023,1,RW,MixedBits,Enable DirectSwitch on DI 1.2,1,Basic" << false << ModbusMap::DirectSwitchEnable << 1023 << 1 << "1.2";
+    QTest::newRow("directswitch toggle") << "1024,1024,1,RW,MixedBits,Enable DirectSwitch Toggle on DI 1.10,9,Basic" << false << ModbusMap::DirectSwitchToggle << 1024 << 9 << "1.10";
+    QTest::newRow("directswitch invert") << "1025,1025,1,RW,MixedBits,Invert DirectSwitch Polarity on DI 1.1,0,Basic" << false << ModbusMap::DirectSwitchInvert << 1025 << 0 << "1.1";
+    QTest::newRow("analog input") << "3,3,2,R,Real,Analog Input Value 1.1,,Basic" << false << ModbusMap::AnalogInput << 3 << -1 << "1.1";
+    QTest::newRow("analog output") << "2,2,1,RW,Word,Analog Output Value 1.1 (0..4000 ~ 0..10V),,Basic" << false << ModbusMap::AnalogOutput << 2 << -1 << "1.1";
+    QTest::newRow("counter") << "3,3,2,RW,DWord,Counter of Digital Input 1.1,,Basic" << false << ModbusMap::DigitalInputCounter << 3 << -1 << "1.1";
+    QTest::newRow("pwm duty cycle") << "17,17,1,RW,Word,PWM Duty Cycle of DO 1.3,,Basic" << false << ModbusMap::PwmDutyCycle << 17 << -1 << "1.3";
+    QTest::newRow("pwm prescaler") << "1017,1017,1,RW,Word,PWM Group prescaler,,Basic" << false << ModbusMap::PwmPrescaler << 1017 << -1 << "prescaler";
+    QTest::newRow("pwm cycle length") << "1018,1018,1,RW,Word,PWM Group cycle length,,Basic" << false << ModbusMap::PwmCycleLength << 1018 << -1 << "length";
+    QTest::newRow("debounce time") << "1010,1010,1,RW,Word,Debounce time (in 100us) for DI 1.4,,Advanced" << false << ModbusMap::DebounceTime << 1010 << -1 << "1.4";
+    QTest::newRow("watchdog status") << "2,2,1,RW,MixedBits,Group MasterWatchDog (MWD) Status,,Advanced" << false << ModbusMap::WatchdogStatus << 2 << -1 << "Status";
+    QTest::newRow("watchdog timeout") << "1008,1008,1,RW,Word,Group MasterWatchDog (MWD) Timeout (in 1ms),,Advanced" << false << ModbusMap::WatchdogTimeout << 1008 << -1 << "Timeout";
+}
+
+void TestModbusMap::classify()
+{
+    QFETCH(QString, row);
+    QFETCH(bool, coils);
+    QFETCH(ModbusMap::EntryType, type);
+    QFETCH(int, address);
+    QFETCH(int, bit);
+    QFETCH(QString, circuit);
+
+    ModbusMap::Entry entry;
+    QVERIFY(ModbusMap::classify(row.split(','), coils, entry));
+    QCOMPARE(entry.type, type);
+    QCOMPARE(entry.address, address);
+    QCOMPARE(entry.bit, bit);
+    QCOMPARE(entry.circuit, circuit);
+}
+
+void TestModbusMap::ignoredRows_data()
+{
+    QTest::addColumn<QString>("row");
+    QTest::addColumn<bool>("coils");
+
+    QTest::newRow("short coil row") << "0,0,R,Digital Input 1.1" << true;
+    QTest::newRow("short register row") << "0,0,1,R,MixedBits,Digital Input 1.1,0" << false;
+    QTest::newRow("advanced coil") << "0,0,R,Digital Input 1.1,Advanced" << true;
+    QTest::newRow("obsolete register") << "5,5,1,R,Word,Analog Input (raw value) 1.1,,Obsolete" << false;
+    QTest::newRow("expert register") << "1020,1020,1,RW,Word,Analog Input Voltage offset 1.1,,Expert" << false;
+    QTest::newRow("analog configuration") << "1019,1019,1,RW,Word,Analog Input Configuration(U/I) 1.1,,Basic" << false;
+    QTest::newRow("mixed bits without bit") << "31,31,1,RW,MixedBits,Digital Input 1.1,,Basic" << false;
+    QTest::newRow("user led register") << "20,20,1,RW,MixedBits,User LED 1.1,0,Basic" << false;
+}
+
+void TestModbusMap::ignoredRows()
+{
+    QFETCH(QString, row);
+    QFETCH(bool, coils);
+
+    ModbusMap::Entry entry;
+    QVERIFY(!ModbusMap::classify(row.split(','), coils, entry));
+}
+
+void TestModbusMap::analogFormat()
+{
+    ModbusMap::Entry entry;
+    QVERIFY(ModbusMap::classify(QString("2,2,1,RW,Word,Analog Output Value 1.1 (0..4000 ~ 0..10V),,Basic").split(','), false, entry));
+    QCOMPARE(entry.format.dataType, ModbusValueCodec::Word);
+    QCOMPARE(entry.format.scale, 0.0025);
+
+    QVERIFY(ModbusMap::classify(QString("3,3,2,R,Real,Analog Input value 2.1,,Basic").split(','), false, entry));
+    QCOMPARE(entry.format.dataType, ModbusValueCodec::Real);
+    QCOMPARE(entry.format.scale, 1.0);
+
+    // Rows that aren't analog values keep the default format
+    QVERIFY(ModbusMap::classify(QString("3,3,2,RW,DWord,Counter of Digital Input 1.1,,Basic").split(','), false, entry));
+    QCOMPARE(entry.format.dataType, ModbusValueCodec::Word);
+}
+
+QTEST_GUILESS_MAIN(TestModbusMap)
+
+#include "tst_modbusmap.moc"
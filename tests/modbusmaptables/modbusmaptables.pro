@@ -0,0 +1,18 @@
+include(../tests.pri)
+include($$PLUGIN_DIR/modbusmaptables.pri)
+
+TARGET = tst_modbusmaptables
+
+INCLUDEPATH += $$PWD/..
+DEFINES += MODBUS_MAPS_DIR=\\\"$$PLUGIN_DIR/modbus_maps\\\"
+
+SOURCES += \
+    tst_modbusmaptables.cpp \
+    ../extern-plugininfo.cpp \
+    $$PLUGIN_DIR/modbusmap.cpp \
+    $$PLUGIN_DIR/modbusvaluecodec.cpp
+
+HEADERS += \
+    ../extern-plugininfo.h \
+    $$PLUGIN_DIR/modbusmap.h \
+    $$PLUGIN_DIR/modbusvaluecodec.h
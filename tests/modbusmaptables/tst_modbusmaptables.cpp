@@ -0,0 +1,124 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusmap.h"
+#include "modbusmaptables.h"
+
+#include <QtTest>
+#include <QDirIterator>
+
+static const int fileCount = sizeof(ModbusMapTables::files) / sizeof(ModbusMap::CompiledFile);
+
+// The tables generated by modbusmapgenerator.py must match what
+// ModbusMap::classify() makes of the same CSV files
+class TestModbusMapTables : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sortedPaths();
+    void allFilesGenerated();
+    void tables_data();
+    void tables();
+};
+
+void TestModbusMapTables::sortedPaths()
+{
+    // ModbusMap::loadCompiled() looks the files up with a binary search
+    for (int i = 1; i < fileCount; i++) {
+        QVERIFY2(qstrcmp(ModbusMapTables::files[i - 1].path, ModbusMapTables::files[i].path) < 0, ModbusMapTables::files[i].path);
+    }
+}
+
+void TestModbusMapTables::allFilesGenerated()
+{
+    QStringList generated;
+    for (int i = 0; i < fileCount; i++) {
+        generated.append(QString::fromLatin1(ModbusMapTables::files[i].path));
+    }
+
+    QDir mapDirectory(MODBUS_MAPS_DIR);
+    QDirIterator iterator(MODBUS_MAPS_DIR, QStringList() << "*.csv", QDir::Files, QDirIterator::Subdirectories);
+    int count = 0;
+    while (iterator.hasNext()) {
+        QString path = "/" + mapDirectory.relativeFilePath(iterator.next());
+        QVERIFY2(generated.contains(path), qPrintable(path));
+        count++;
+    }
+    QCOMPARE(count, fileCount);
+}
+
+void TestModbusMapTables::tables_data()
+{
+    QTest::addColumn<int>("index");
+
+    for (int i = 0; i < fileCount; i++) {
+        QTest::newRow(ModbusMapTables::files[i].path) << i;
+    }
+}
+
+void TestModbusMapTables::tables()
+{
+    QFETCH(int, index);
+
+    const ModbusMap::CompiledFile &file = ModbusMapTables::files[index];
+    QString path = QString::fromLatin1(file.path);
+    bool coils = path.contains("-Coils-");
+
+    QFile csvFile(MODBUS_MAPS_DIR + path);
+    QVERIFY2(csvFile.open(QIODevice::ReadOnly), qPrintable(csvFile.errorString()));
+
+    QVector<ModbusMap::Entry> entries;
+    while (!csvFile.atEnd()) {
+        QString line = QString::fromLatin1(csvFile.readLine());
+        line.remove('\r');
+        line.remove('\n');
+        ModbusMap::Entry entry;
+        if (ModbusMap::classify(line.split(','), coils, entry))
+            entries.append(entry);
+    }
+
+    QCOMPARE(file.count, entries.count());
+    for (int i = 0; i < entries.count(); i++) {
+        const ModbusMap::CompiledEntry &compiled = file.entries[i];
+        const ModbusMap::Entry &entry = entries.at(i);
+        QCOMPARE(compiled.type, entry.type);
+        QCOMPARE(compiled.address, entry.address);
+        QCOMPARE(compiled.bit, entry.bit);
+        QCOMPARE(QString::fromLatin1(compiled.circuit), entry.circuit);
+        QCOMPARE(compiled.dataType, entry.format.dataType);
+        QCOMPARE(compiled.scale, entry.format.scale);
+        QCOMPARE(compiled.offset, entry.format.offset);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestModbusMapTables)
+
+#include "tst_modbusmaptables.moc"
@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_modbusreadplan
+
+SOURCES += \
+    tst_modbusreadplan.cpp \
+    $$PLUGIN_DIR/modbusreadplan.cpp
+
+HEADERS += \
+    $$PLUGIN_DIR/modbusreadplan.h
@@ -0,0 +1,147 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusreadplan.h"
+
+#include <QtTest>
+
+typedef QPair<int, int> Block;
+
+class TestModbusReadPlan : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyPlan();
+    void mergeAdjacentSpans();
+    void mergeOverlappingSpans();
+    void unsortedSpans();
+    void gapTolerance();
+    void registerLimit();
+    void coilLimit();
+    void invalidSpans();
+    void registerType();
+
+private:
+    static QList<Block> blocks(const ModbusReadPlan &plan);
+};
+
+QList<Block> TestModbusReadPlan::blocks(const ModbusReadPlan &plan)
+{
+    QList<Block> blocks;
+    foreach (const QModbusDataUnit &request, plan.requests()) {
+        blocks.append(qMakePair(request.startAddress(), static_cast<int>(request.valueCount())));
+    }
+    return blocks;
+}
+
+void TestModbusReadPlan::emptyPlan()
+{
+    ModbusReadPlan plan(QModbusDataUnit::HoldingRegisters, 4);
+    QVERIFY(plan.requests().isEmpty());
+}
+
+void TestModbusReadPlan::mergeAdjacentSpans()
+{
+    ModbusReadPlan plan(QModbusDataUnit::Coils);
+    plan.addAddresses(QList<int>() << 0 << 1 << 2 << 3);
+    QCOMPARE(blocks(plan), QList<Block>() << Block(0, 4));
+}
+
+void TestModbusReadPlan::mergeOverlappingSpans()
+{
+    ModbusReadPlan plan(QModbusDataUnit::InputRegisters);
+    plan.addSpan(10, 4);
+    plan.addSpan(12, 2);
+    plan.addSpan(13, 3);
+    QCOMPARE(blocks(plan), QList<Block>() << Block(10, 6));
+}
+
+void TestModbusReadPlan::unsortedSpans()
+{
+    ModbusReadPlan plan(QModbusDataUnit::HoldingRegisters);
+    plan.addAddresses(QList<int>() << 21 << 3 << 20 << 2);
+    QCOMPARE(blocks(plan), QList<Block>() << Block(2, 2) << Block(20, 2));
+}
+
+void TestModbusReadPlan::gapTolerance()
+{
+    // A hole of two addresses is read over with a tolerance of two, not with one
+    ModbusReadPlan merged(QModbusDataUnit::HoldingRegisters, 2);
+    merged.addAddresses(QList<int>() << 0 << 3);
+    QCOMPARE(blocks(merged), QList<Block>() << Block(0, 4));
+
+    ModbusReadPlan split(QModbusDataUnit::HoldingRegisters, 1);
+    split.addAddresses(QList<int>() << 0 << 3);
+    QCOMPARE(blocks(split), QList<Block>() << Block(0, 1) << Block(3, 1));
+}
+
+void TestModbusReadPlan::registerLimit()
+{
+    ModbusReadPlan full(QModbusDataUnit::HoldingRegisters);
+    full.addSpan(0, 100);
+    full.addSpan(100, 25);
+    QCOMPARE(blocks(full), QList<Block>() << Block(0, ModbusReadPlan::maxRegisterCount));
+
+    ModbusReadPlan split(QModbusDataUnit::HoldingRegisters, 10);
+    split.addSpan(0, 100);
+    split.addSpan(105, 25);
+    QCOMPARE(blocks(split), QList<Block>() << Block(0, 100) << Block(105, 25));
+}
+
+void TestModbusReadPlan::coilLimit()
+{
+    ModbusReadPlan plan(QModbusDataUnit::Coils);
+    plan.addSpan(0, 1500);
+    plan.addSpan(1500, 500);
+    plan.addSpan(2000, 1);
+    QCOMPARE(blocks(plan), QList<Block>() << Block(0, ModbusReadPlan::maxCoilCount) << Block(2000, 1));
+}
+
+void TestModbusReadPlan::invalidSpans()
+{
+    ModbusReadPlan plan(QModbusDataUnit::Coils);
+    plan.addSpan(-1);
+    plan.addSpan(5, 0);
+    QVERIFY(plan.requests().isEmpty());
+}
+
+void TestModbusReadPlan::registerType()
+{
+    ModbusReadPlan plan(QModbusDataUnit::DiscreteInputs);
+    plan.addAddresses(QList<int>() << 0 << 50);
+    foreach (const QModbusDataUnit &request, plan.requests()) {
+        QCOMPARE(request.registerType(), QModbusDataUnit::DiscreteInputs);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestModbusReadPlan)
+
+#include "tst_modbusreadplan.moc"
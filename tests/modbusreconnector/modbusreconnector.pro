@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+TARGET = tst_modbusreconnector
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    tst_modbusreconnector.cpp \
+    ../extern-plugininfo.cpp \
+    $$PLUGIN_DIR/modbusreconnector.cpp
+
+HEADERS += \
+    ../extern-plugininfo.h \
+    $$PLUGIN_DIR/modbusreconnector.h
@@ -0,0 +1,161 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusreconnector.h"
+
+#include <QtTest>
+
+// Connects only when told to, counting the attempts
+class FakeModbusDevice : public QModbusDevice
+{
+    Q_OBJECT
+public:
+    using QModbusDevice::setState;
+
+    bool reachable = false;
+    int openCount = 0;
+
+protected:
+    bool open() override
+    {
+        openCount++;
+        if (!reachable)
+            return false;
+
+        setState(QModbusDevice::ConnectedState);
+        return true;
+    }
+
+    void close() override
+    {
+        setState(QModbusDevice::UnconnectedState);
+    }
+};
+
+class TestModbusReconnector : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void firstAttemptImmediately();
+    void exponentialBackoff();
+    void flappingConnection();
+    void reconnect();
+    void stop();
+};
+
+void TestModbusReconnector::firstAttemptImmediately()
+{
+    FakeModbusDevice device;
+    ModbusReconnector reconnector(&device, "test");
+    QSignalSpy retrySpy(&reconnector, &ModbusReconnector::retryChanged);
+
+    device.setState(QModbusDevice::ConnectingState);
+    device.setState(QModbusDevice::UnconnectedState);
+    QCOMPARE(reconnector.attempt(), 1);
+    QCOMPARE(retrySpy.count(), 1);
+    QVERIFY(QDateTime::currentDateTime().msecsTo(reconnector.nextRetry()) <= 0);
+    QTRY_COMPARE(device.openCount, 1);
+}
+
+void TestModbusReconnector::exponentialBackoff()
+{
+    FakeModbusDevice device;
+    ModbusReconnector reconnector(&device, "test");
+    reconnector.setBackoff(40, 160);
+
+    // Delay of each scheduled attempt, taken when it is scheduled
+    QHash<int, qint64> delays;
+    connect(&reconnector, &ModbusReconnector::retryChanged, this, [&reconnector, &delays] {
+        if (reconnector.nextRetry().isValid())
+            delays.insert(reconnector.attempt(), QDateTime::currentDateTime().msecsTo(reconnector.nextRetry()));
+    });
+
+    device.setState(QModbusDevice::ConnectingState);
+    device.setState(QModbusDevice::UnconnectedState);
+    QTRY_VERIFY_WITH_TIMEOUT(reconnector.attempt() >= 6, 2000);
+    reconnector.stop();
+
+    // Half of each delay is random: 0, 20..40, 40..80, 80..160, then capped at 80..160
+    QVERIFY(delays.value(1) <= 0);
+    int nominal = 40;
+    for (int attempt = 2; attempt <= 5; attempt++) {
+        QVERIFY2(delays.value(attempt) >= nominal / 2 - 5 && delays.value(attempt) <= nominal, qPrintable(QString::number(attempt)));
+        nominal = qMin(nominal * 2, 160);
+    }
+}
+
+void TestModbusReconnector::flappingConnection()
+{
+    // A connection that drops right after it came up backs off instead of retrying at once
+    FakeModbusDevice device;
+    ModbusReconnector reconnector(&device, "test");
+    reconnector.setBackoff(1000, 1000);
+    device.setState(QModbusDevice::ConnectedState);
+    device.setState(QModbusDevice::UnconnectedState);
+    QCOMPARE(reconnector.attempt(), 2);
+    QVERIFY(QDateTime::currentDateTime().msecsTo(reconnector.nextRetry()) >= 450);
+    reconnector.stop();
+}
+
+void TestModbusReconnector::reconnect()
+{
+    FakeModbusDevice device;
+    ModbusReconnector reconnector(&device, "test");
+    reconnector.setBackoff(20, 20);
+    device.setState(QModbusDevice::ConnectingState);
+    device.setState(QModbusDevice::UnconnectedState);
+    QTRY_VERIFY(reconnector.attempt() >= 3);
+
+    device.reachable = true;
+    QTRY_COMPARE(device.state(), QModbusDevice::ConnectedState);
+    QCOMPARE(reconnector.attempt(), 0);
+    QVERIFY(!reconnector.nextRetry().isValid());
+}
+
+void TestModbusReconnector::stop()
+{
+    FakeModbusDevice device;
+    ModbusReconnector reconnector(&device, "test");
+    reconnector.setBackoff(20, 20);
+    device.setState(QModbusDevice::ConnectingState);
+    device.setState(QModbusDevice::UnconnectedState);
+    QTRY_VERIFY(device.openCount >= 2);
+
+    reconnector.stop();
+    QVERIFY(!reconnector.nextRetry().isValid());
+    int openCount = device.openCount;
+    QTest::qWait(100);
+    QCOMPARE(device.openCount, openCount);
+}
+
+QTEST_GUILESS_MAIN(TestModbusReconnector)
+
+#include "tst_modbusreconnector.moc"
@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_modbusrttestimator
+
+SOURCES += \
+    tst_modbusrttestimator.cpp \
+    $$PLUGIN_DIR/modbusrttestimator.cpp
+
+HEADERS += \
+    $$PLUGIN_DIR/modbusrttestimator.h
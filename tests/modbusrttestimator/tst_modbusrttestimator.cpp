@@ -0,0 +1,117 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusrttestimator.h"
+
+#include <QtTest>
+
+class TestModbusRttEstimator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initialTimeout();
+    void firstSample();
+    void smoothing();
+    void bounds();
+    void retries();
+};
+
+void TestModbusRttEstimator::initialTimeout()
+{
+    ModbusRttEstimator estimator(300, 10, 1000);
+    QVERIFY(!estimator.hasSamples());
+    QCOMPARE(estimator.timeout(), 300);
+    QCOMPARE(estimator.retries(), 1);
+
+    QCOMPARE(ModbusRttEstimator(5000, 10, 1000).timeout(), 1000);
+}
+
+void TestModbusRttEstimator::firstSample()
+{
+    // srtt = r, rttvar = r / 2, timeout = srtt + 4 * rttvar
+    ModbusRttEstimator estimator(1000, 1, 1000);
+    estimator.addSample(20);
+    QVERIFY(estimator.hasSamples());
+    QCOMPARE(estimator.smoothedRtt(), 20.0);
+    QCOMPARE(estimator.timeout(), 60);
+}
+
+void TestModbusRttEstimator::smoothing()
+{
+    ModbusRttEstimator estimator(1000, 1, 1000);
+    estimator.addSample(20);
+    estimator.addSample(20);
+    QCOMPARE(estimator.smoothedRtt(), 20.0);
+    QCOMPARE(estimator.timeout(), 50);
+
+    // One slow response moves the estimate by an eighth, the variance
+    // by a quarter of the deviation: 30 + 4 * (0.75 * 7.5 + 0.25 * 80)
+    estimator.addSample(100);
+    QCOMPARE(estimator.smoothedRtt(), 30.0);
+    QCOMPARE(estimator.timeout(), 133);
+}
+
+void TestModbusRttEstimator::bounds()
+{
+    ModbusRttEstimator fast(1000, 10, 1000);
+    fast.addSample(0);
+    QCOMPARE(fast.timeout(), 10);
+
+    ModbusRttEstimator slow(1000, 10, 200);
+    slow.addSample(150);
+    QCOMPARE(slow.timeout(), 200);
+
+    // Negative samples from a clock jump count as zero
+    ModbusRttEstimator negative(1000, 1, 1000);
+    negative.addSample(-50);
+    QCOMPARE(negative.smoothedRtt(), 0.0);
+    QCOMPARE(negative.timeout(), 1);
+}
+
+void TestModbusRttEstimator::retries()
+{
+    ModbusRttEstimator estimator;
+    estimator.addSample(20);
+    estimator.addTimeout();
+    QCOMPARE(estimator.retries(), 1);
+    estimator.addTimeout();
+    QCOMPARE(estimator.retries(), 0);
+
+    // The timeout itself isn't backed off
+    QCOMPARE(estimator.timeout(), 60);
+
+    estimator.addSample(20);
+    QCOMPARE(estimator.retries(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestModbusRttEstimator)
+
+#include "tst_modbusrttestimator.moc"
@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+TARGET = tst_modbustimeoutwheel
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    tst_modbustimeoutwheel.cpp \
+    ../extern-plugininfo.cpp \
+    $$PLUGIN_DIR/modbustimeoutwheel.cpp
+
+HEADERS += \
+    ../extern-plugininfo.h \
+    $$PLUGIN_DIR/modbustimeoutwheel.h
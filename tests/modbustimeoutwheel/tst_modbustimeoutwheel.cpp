@@ -0,0 +1,118 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbustimeoutwheel.h"
+
+#include <QtTest>
+
+class TestModbusTimeoutWheel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void timeout();
+    void finishedReply();
+    void deletedReply();
+    void laterRound();
+    void invalidReply();
+};
+
+void TestModbusTimeoutWheel::timeout()
+{
+    ModbusTimeoutWheel wheel(10);
+    QModbusReply reply(QModbusReply::Common, 1);
+    QSignalSpy finishedSpy(&reply, &QModbusReply::finished);
+    QElapsedTimer clock;
+    clock.start();
+
+    wheel.track(&reply, 50);
+    QCOMPARE(wheel.pendingCount(), 1);
+    QTRY_COMPARE(finishedSpy.count(), 1);
+    QVERIFY(clock.elapsed() >= 40);
+    QCOMPARE(reply.error(), QModbusDevice::TimeoutError);
+    QCOMPARE(wheel.timeoutCount(), 1);
+    QCOMPARE(wheel.pendingCount(), 0);
+}
+
+void TestModbusTimeoutWheel::finishedReply()
+{
+    ModbusTimeoutWheel wheel(10);
+    QModbusReply reply(QModbusReply::Common, 1);
+    wheel.track(&reply, 20);
+    reply.setFinished(true);
+    QCOMPARE(wheel.pendingCount(), 0);
+
+    QTest::qWait(100);
+    QCOMPARE(reply.error(), QModbusDevice::NoError);
+    QCOMPARE(wheel.timeoutCount(), 0);
+}
+
+void TestModbusTimeoutWheel::deletedReply()
+{
+    ModbusTimeoutWheel wheel(10);
+    QModbusReply *reply = new QModbusReply(QModbusReply::Common, 1);
+    wheel.track(reply, 20);
+    delete reply;
+    QCOMPARE(wheel.pendingCount(), 0);
+
+    QTest::qWait(100);
+    QCOMPARE(wheel.timeoutCount(), 0);
+}
+
+void TestModbusTimeoutWheel::laterRound()
+{
+    // 200 ticks of 5 ms go around the 64 slots of the wheel three times
+    ModbusTimeoutWheel wheel(5);
+    QModbusReply reply(QModbusReply::Common, 1);
+    QModbusReply shortReply(QModbusReply::Common, 1);
+    wheel.track(&reply, 1000);
+    wheel.track(&shortReply, 20);
+
+    QTRY_COMPARE(shortReply.error(), QModbusDevice::TimeoutError);
+    QTest::qWait(400);
+    QCOMPARE(reply.error(), QModbusDevice::NoError);
+    QCOMPARE(wheel.pendingCount(), 1);
+    QTRY_COMPARE_WITH_TIMEOUT(reply.error(), QModbusDevice::TimeoutError, 2000);
+    QCOMPARE(wheel.timeoutCount(), 2);
+}
+
+void TestModbusTimeoutWheel::invalidReply()
+{
+    ModbusTimeoutWheel wheel(10);
+    wheel.track(nullptr, 20);
+    QModbusReply reply(QModbusReply::Common, 1);
+    reply.setFinished(true);
+    wheel.track(&reply, 20);
+    QCOMPARE(wheel.pendingCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestModbusTimeoutWheel)
+
+#include "tst_modbustimeoutwheel.moc"
@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_modbustransactionwindow
+
+SOURCES += \
+    tst_modbustransactionwindow.cpp \
+    $$PLUGIN_DIR/modbustransactionwindow.cpp
+
+HEADERS += \
+    $$PLUGIN_DIR/modbustransactionwindow.h
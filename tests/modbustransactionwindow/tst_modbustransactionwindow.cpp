@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbustransactionwindow.h"
+
+#include <QtTest>
+
+class TestModbusTransactionWindow : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void track();
+    void resize();
+};
+
+void TestModbusTransactionWindow::track()
+{
+    ModbusTransactionWindow window;
+    window.setSize(2);
+    QSignalSpy availableSpy(&window, &ModbusTransactionWindow::available);
+
+    QModbusReply *first = new QModbusReply(QModbusReply::Common, 1);
+    QModbusReply *second = new QModbusReply(QModbusReply::Common, 2);
+    window.track(first);
+    QVERIFY(!window.isFull());
+    window.track(second);
+    QVERIFY(window.isFull());
+    QCOMPARE(window.pendingCount(), 2);
+
+    // A reply counts until it is deleted, not when it finishes
+    first->setFinished(true);
+    QVERIFY(window.isFull());
+    delete first;
+    QVERIFY(!window.isFull());
+    QCOMPARE(availableSpy.count(), 1);
+
+    delete second;
+    QCOMPARE(window.pendingCount(), 0);
+}
+
+void TestModbusTransactionWindow::resize()
+{
+    ModbusTransactionWindow window;
+    QSignalSpy availableSpy(&window, &ModbusTransactionWindow::available);
+    QModbusReply reply(QModbusReply::Common, 1);
+    window.track(&reply);
+    QVERIFY(window.isFull());
+
+    window.setSize(0);
+    QCOMPARE(window.size(), 1);
+    QCOMPARE(availableSpy.count(), 0);
+
+    window.setSize(4);
+    QVERIFY(!window.isFull());
+    QCOMPARE(availableSpy.count(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestModbusTransactionWindow)
+
+#include "tst_modbustransactionwindow.moc"
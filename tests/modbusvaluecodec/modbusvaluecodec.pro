@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_modbusvaluecodec
+
+SOURCES += \
+    tst_modbusvaluecodec.cpp \
+    $$PLUGIN_DIR/modbusvaluecodec.cpp
+
+HEADERS += \
+    $$PLUGIN_DIR/modbusvaluecodec.h
@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusvaluecodec.h"
+
+#include <QtTest>
+
+Q_DECLARE_METATYPE(ModbusValueCodec::DataType)
+Q_DECLARE_METATYPE(ModbusValueCodec::WordOrder)
+
+class TestModbusValueCodec : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void format_data();
+    void format();
+    void decode_data();
+    void decode();
+    void encode_data();
+    void encode();
+    void scaling();
+    void clampWord();
+};
+
+void TestModbusValueCodec::format_data()
+{
+    QTest::addColumn<QString>("dataType");
+    QTest::addColumn<QString>("description");
+    QTest::addColumn<ModbusValueCodec::DataType>("expectedType");
+    QTest::addColumn<double>("scale");
+    QTest::addColumn<double>("offset");
+
+    QTest::newRow("word") << "Word" << "Analog Input Value 1.1" << ModbusValueCodec::Word << 1.0 << 0.0;
+    QTest::newRow("unknown") << "Bits" << "Analog Input Value 1.1" << ModbusValueCodec::Word << 1.0 << 0.0;
+    QTest::newRow("dword") << "dword" << "Counter" << ModbusValueCodec::DWord << 1.0 << 0.0;
+    QTest::newRow("real") << "Real" << "Analog Input Value 2.1" << ModbusValueCodec::Real << 1.0 << 0.0;
+    QTest::newRow("float") << "FLOAT" << "Analog Input Value 2.1" << ModbusValueCodec::Real << 1.0 << 0.0;
+    QTest::newRow("mixed bits") << "MixedBits" << "Digital Input 1.1" << ModbusValueCodec::MixedBits << 1.0 << 0.0;
+    QTest::newRow("range") << "Word" << "Analog Output Value 1.1 (0..4000 ~ 0..10V)" << ModbusValueCodec::Word << 0.0025 << 0.0;
+    QTest::newRow("offset range") << "Word" << "Analog Input Value 1.1 (1000..5000 ~ 0..100)" << ModbusValueCodec::Word << 0.025 << -25.0;
+    QTest::newRow("negative range") << "Word" << "Analog Input Value 1.1 (0..2000 ~ -10..10 V)" << ModbusValueCodec::Word << 0.01 << -10.0;
+    QTest::newRow("empty range") << "Word" << "Analog Input Value 1.1 (5..5 ~ 0..10)" << ModbusValueCodec::Word << 1.0 << 0.0;
+}
+
+void TestModbusValueCodec::format()
+{
+    QFETCH(QString, dataType);
+    QFETCH(QString, description);
+    QFETCH(ModbusValueCodec::DataType, expectedType);
+    QFETCH(double, scale);
+    QFETCH(double, offset);
+
+    ModbusValueCodec::Format format = ModbusValueCodec::format(dataType, description);
+    QCOMPARE(format.dataType, expectedType);
+    QCOMPARE(format.scale, scale);
+    QVERIFY(qAbs(format.offset - offset) < 1e-9);
+}
+
+void TestModbusValueCodec::decode_data()
+{
+    QTest::addColumn<ModbusValueCodec::DataType>("dataType");
+    QTest::addColumn<ModbusValueCodec::WordOrder>("wordOrder");
+    QTest::addColumn<QVector<quint16> >("words");
+    QTest::addColumn<double>("value");
+
+    QTest::newRow("word") << ModbusValueCodec::Word << ModbusValueCodec::HighWordFirst << (QVector<quint16>() << 1234) << 1234.0;
+    QTest::newRow("mixed bits") << ModbusValueCodec::MixedBits << ModbusValueCodec::LowWordFirst << (QVector<quint16>() << 0x8001) << 32769.0;
+    QTest::newRow("dword high first") << ModbusValueCodec::DWord << ModbusValueCodec::HighWordFirst << (QVector<quint16>() << 0x0001 << 0x0002) << 65538.0;
+    QTest::newRow("dword low first") << ModbusValueCodec::DWord << ModbusValueCodec::LowWordFirst << (QVector<quint16>() << 0x0001 << 0x0002) << 131073.0;
+    QTest::newRow("dword max") << ModbusValueCodec::DWord << ModbusValueCodec::HighWordFirst << (QVector<quint16>() << 0xffff << 0xffff) << 4294967295.0;
+    QTest::newRow("real high first") << ModbusValueCodec::Real << ModbusValueCodec::HighWordFirst << (QVector<quint16>() << 0x3fc0 << 0x0000) << 1.5;
+    QTest::newRow("real low first") << ModbusValueCodec::Real << ModbusValueCodec::LowWordFirst << (QVector<quint16>() << 0x0000 << 0x3fc0) << 1.5;
+    QTest::newRow("negative real") << ModbusValueCodec::Real << ModbusValueCodec::HighWordFirst << (QVector<quint16>() << 0xc120 << 0x0000) << -10.0;
+}
+
+void TestModbusValueCodec::decode()
+{
+    QFETCH(ModbusValueCodec::DataType, dataType);
+    QFETCH(ModbusValueCodec::WordOrder, wordOrder);
+    QFETCH(QVector<quint16>, words);
+    QFETCH(double, value);
+
+    ModbusValueCodec::Format format;
+    format.dataType = dataType;
+    ModbusValueCodec codec(format, wordOrder);
+    QCOMPARE(codec.wordCount(), words.count());
+    QCOMPARE(codec.decode(words.constData()), value);
+}
+
+void TestModbusValueCodec::encode_data()
+{
+    decode_data();
+}
+
+void TestModbusValueCodec::encode()
+{
+    QFETCH(ModbusValueCodec::DataType, dataType);
+    QFETCH(ModbusValueCodec::WordOrder, wordOrder);
+    QFETCH(QVector<quint16>, words);
+    QFETCH(double, value);
+
+    ModbusValueCodec::Format format;
+    format.dataType = dataType;
+    ModbusValueCodec codec(format, wordOrder);
+    QCOMPARE(codec.encode(value), words);
+}
+
+void TestModbusValueCodec::scaling()
+{
+    ModbusValueCodec codec(ModbusValueCodec::format("Word", "Analog Output Value 1.1 (0..4000 ~ 0..10V)"), ModbusValueCodec::HighWordFirst);
+    quint16 raw = 2000;
+    QCOMPARE(codec.decode(&raw), 5.0);
+    QCOMPARE(codec.encode(5.0), QVector<quint16>() << 2000);
+    QCOMPARE(codec.encode(10.0), QVector<quint16>() << 4000);
+
+    ModbusValueCodec real(ModbusValueCodec::format("Real", "Analog Input Value 1.1 (0..1 ~ 0..100)"), ModbusValueCodec::LowWordFirst);
+    QVector<quint16> words = real.encode(150.0);
+    QCOMPARE(real.decode(words.constData()), 150.0);
+}
+
+void TestModbusValueCodec::clampWord()
+{
+    ModbusValueCodec codec;
+    QCOMPARE(codec.encode(-5.0), QVector<quint16>() << 0);
+    QCOMPARE(codec.encode(70000.0), QVector<quint16>() << 65535);
+    QCOMPARE(codec.encode(12.6), QVector<quint16>() << 13);
+}
+
+QTEST_GUILESS_MAIN(TestModbusValueCodec)
+
+#include "tst_modbusvaluecodec.moc"
@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_modbusvalueimage
+
+SOURCES += \
+    tst_modbusvalueimage.cpp \
+    $$PLUGIN_DIR/modbusvalueimage.cpp
+
+HEADERS += \
+    $$PLUGIN_DIR/modbusvalueimage.h
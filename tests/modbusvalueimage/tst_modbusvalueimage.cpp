@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "modbusvalueimage.h"
+
+#include <QtTest>
+
+class TestModbusValueImage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void firstRegisterRead();
+    void unchangedRegisters();
+    void changedRegisterBits();
+    void coils();
+    void coilsAcrossWords();
+    void growKeepsValues();
+    void invalidate();
+    void invalidUnit();
+
+private:
+    static QModbusDataUnit unit(QModbusDataUnit::RegisterType registerType, int address, const QVector<quint16> &values);
+};
+
+QModbusDataUnit TestModbusValueImage::unit(QModbusDataUnit::RegisterType registerType, int address, const QVector<quint16> &values)
+{
+    return QModbusDataUnit(registerType, address, values);
+}
+
+void TestModbusValueImage::firstRegisterRead()
+{
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    QVERIFY(!image.isValid(QModbusDataUnit::HoldingRegisters, 100));
+    QVERIFY(image.update(unit(QModbusDataUnit::HoldingRegisters, 100, QVector<quint16>() << 0 << 7), changedBits));
+    QCOMPARE(changedBits, QVector<quint16>() << 0xffff << 0xffff);
+    QVERIFY(image.isValid(QModbusDataUnit::HoldingRegisters, 100));
+    QCOMPARE(image.value(QModbusDataUnit::HoldingRegisters, 101), quint16(7));
+    QVERIFY(!image.isValid(QModbusDataUnit::InputRegisters, 100));
+}
+
+void TestModbusValueImage::unchangedRegisters()
+{
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    image.update(unit(QModbusDataUnit::InputRegisters, 0, QVector<quint16>() << 1 << 2 << 3), changedBits);
+    QVERIFY(!image.update(unit(QModbusDataUnit::InputRegisters, 0, QVector<quint16>() << 1 << 2 << 3), changedBits));
+    QCOMPARE(changedBits, QVector<quint16>() << 0 << 0 << 0);
+}
+
+void TestModbusValueImage::changedRegisterBits()
+{
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    image.update(unit(QModbusDataUnit::HoldingRegisters, 0, QVector<quint16>() << 0x00f0 << 5), changedBits);
+    QVERIFY(image.update(unit(QModbusDataUnit::HoldingRegisters, 0, QVector<quint16>() << 0x0f00 << 5), changedBits));
+    QCOMPARE(changedBits, QVector<quint16>() << 0x0ff0 << 0);
+    QCOMPARE(image.value(QModbusDataUnit::HoldingRegisters, 0), quint16(0x0f00));
+}
+
+void TestModbusValueImage::coils()
+{
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    QVERIFY(image.update(unit(QModbusDataUnit::Coils, 0, QVector<quint16>() << 1 << 0 << 1), changedBits));
+    QCOMPARE(changedBits, QVector<quint16>() << 1 << 1 << 1);
+    QVERIFY(!image.update(unit(QModbusDataUnit::Coils, 0, QVector<quint16>() << 1 << 0 << 1), changedBits));
+    QVERIFY(image.update(unit(QModbusDataUnit::Coils, 0, QVector<quint16>() << 1 << 1 << 1), changedBits));
+    QCOMPARE(changedBits, QVector<quint16>() << 0 << 1 << 0);
+    QCOMPARE(image.value(QModbusDataUnit::Coils, 1), quint16(1));
+}
+
+void TestModbusValueImage::coilsAcrossWords()
+{
+    // Coils 60 to 69 span two 64 bit words of the image
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    QVector<quint16> values(10, 0);
+    image.update(unit(QModbusDataUnit::DiscreteInputs, 60, values), changedBits);
+    values[2] = 1;
+    values[6] = 1;
+    QVERIFY(image.update(unit(QModbusDataUnit::DiscreteInputs, 60, values), changedBits));
+    QCOMPARE(changedBits, values);
+    QCOMPARE(image.value(QModbusDataUnit::DiscreteInputs, 66), quint16(1));
+    QCOMPARE(image.value(QModbusDataUnit::DiscreteInputs, 67), quint16(0));
+}
+
+void TestModbusValueImage::growKeepsValues()
+{
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    image.update(unit(QModbusDataUnit::HoldingRegisters, 200, QVector<quint16>() << 42), changedBits);
+    image.update(unit(QModbusDataUnit::Coils, 200, QVector<quint16>() << 1), changedBits);
+
+    // Reads below and above the known range move the image base
+    image.update(unit(QModbusDataUnit::HoldingRegisters, 10, QVector<quint16>() << 1), changedBits);
+    image.update(unit(QModbusDataUnit::HoldingRegisters, 500, QVector<quint16>() << 2), changedBits);
+    image.update(unit(QModbusDataUnit::Coils, 0, QVector<quint16>() << 0), changedBits);
+    QCOMPARE(image.value(QModbusDataUnit::HoldingRegisters, 200), quint16(42));
+    QCOMPARE(image.value(QModbusDataUnit::Coils, 200), quint16(1));
+    QVERIFY(!image.isValid(QModbusDataUnit::HoldingRegisters, 300));
+    QVERIFY(!image.update(unit(QModbusDataUnit::HoldingRegisters, 200, QVector<quint16>() << 42), changedBits));
+}
+
+void TestModbusValueImage::invalidate()
+{
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    image.update(unit(QModbusDataUnit::HoldingRegisters, 0, QVector<quint16>() << 3), changedBits);
+    image.update(unit(QModbusDataUnit::Coils, 0, QVector<quint16>() << 1), changedBits);
+    image.invalidate();
+    QVERIFY(!image.isValid(QModbusDataUnit::HoldingRegisters, 0));
+
+    // The same values count as changed again after a resync
+    QVERIFY(image.update(unit(QModbusDataUnit::HoldingRegisters, 0, QVector<quint16>() << 3), changedBits));
+    QCOMPARE(changedBits, QVector<quint16>() << 0xffff);
+    QVERIFY(image.update(unit(QModbusDataUnit::Coils, 0, QVector<quint16>() << 1), changedBits));
+    QCOMPARE(changedBits, QVector<quint16>() << 1);
+}
+
+void TestModbusValueImage::invalidUnit()
+{
+    ModbusValueImage image;
+    QVector<quint16> changedBits;
+    QVERIFY(!image.update(QModbusDataUnit(), changedBits));
+    QVERIFY(changedBits.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestModbusValueImage)
+
+#include "tst_modbusvalueimage.moc"
@@ -0,0 +1,11 @@
+# Unit tests of the plugin's Modbus helpers, built without nymea:
+# qmake tests/tests.pro && make check
+
+QT += testlib serialbus
+QT -= gui
+
+CONFIG += testcase console c++11
+CONFIG -= app_bundle
+
+PLUGIN_DIR = $$PWD/..
+INCLUDEPATH += $$PLUGIN_DIR
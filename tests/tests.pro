@@ -0,0 +1,13 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    modbusreadplan \
+    modbusvalueimage \
+    modbusvaluecodec \
+    modbusmap \
+    modbusmaptables \
+    iosnapshot \
+    modbusreconnector \
+    modbustimeoutwheel \
+    modbusrttestimator \
+    modbustransactionwindow \
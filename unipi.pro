@@ -37,7 +37,19 @@ SOURCES += \
     i2cport.cpp \
     unipi.cpp \
     mcp342xchannel.cpp \
-    unipipwm.cpp
+    unipipwm.cpp \
+    modbusreadplan.cpp \
+    neuronextensionbus.cpp \
+    modbusregistertable.cpp \
+    modbusvalueimage.cpp \
+    modbusvaluecodec.cpp \
+    modbusconfigregisters.cpp \
+    modbustimeoutwheel.cpp \
+    modbusrttestimator.cpp \
+    modbusreconnector.cpp \
+    modbustransactionwindow.cpp \
+    iosnapshot.cpp \
+    modbusmap.cpp
 
 HEADERS += \
     integrationpluginunipi.h \
@@ -48,7 +60,26 @@ HEADERS += \
     unipi.h \
     i2cport_p.h \
     mcp342xchannel.h \
-    unipipwm.h
+    unipipwm.h \
+    modbusreadplan.h \
+    neuronextensionbus.h \
+    modbusregistertable.h \
+    modbusvalueimage.h \
+    modbusvaluecodec.h \
+    modbusconfigregisters.h \
+    modbustimeoutwheel.h \
+    modbusrttestimator.h \
+    modbusreconnector.h \
+    modbustransactionwindow.h \
+    iosnapshot.h \
+    modbusmap.h \
+    iochangeset.h
+
+# Compile the modbus maps into constexpr tables, CONFIG+=runtime_modbus_maps
+# builds without them and reads the installed CSV files only
+!CONFIG(runtime_modbus_maps) {
+    include(modbusmaptables.pri)
+}
 
 MAP_FILES.files = files(modbus_maps/*)
 MAP_FILES.path = [QT_INSTALL_PREFIX]/share/nymea/modbus/